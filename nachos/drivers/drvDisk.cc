@@ -11,11 +11,20 @@
 //	pending requests.  And, because the physical disk can only
 //	handle one operation at a time, use a lock to enforce mutual
 //	exclusion.
+//
+//	The file system disk goes through a write-back buffer cache,
+//	so that the sectors of the headers, directories and bitmap it
+//	keeps re-reading are found in memory.
 */
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
+#include <string.h>
+
+#include "kernel/system.h"
+#include "kernel/thread.h"
+#include "utility/config.h"
 #include "drivers/drvDisk.h"
 
 //----------------------------------------------------------------------
@@ -47,29 +56,161 @@ void DiskSwapRequestDone()
 /*! 	Constructor.
 //      Initialize the disk driver, in turn
 //	initializing the physical disk.
+//
+//	\param cacheSectors number of sectors of the buffer cache, 0 for
+//	       a driver going straight to the disk
 */
 //----------------------------------------------------------------------
 
-DriverDisk::DriverDisk(const char* sem_name, const char *lock_name, Disk* theDisk)
+DriverDisk::DriverDisk(const char* sem_name, const char *lock_name, Disk* theDisk,
+		       int cacheSectors)
+  : lru(&buf_c::lruHook)
 {
     semaphore = new Semaphore((char*)sem_name, 0);
     lock = new Lock((char*)lock_name);
     disk = theDisk;
+
+    cacheSize = cacheSectors;
+    bufs = (cacheSize > 0) ? new buf_c[cacheSize] : NULL;
+    for (int i = 0; i < cacheSize; i++) {
+	bufs[i].sector = -1;
+	bufs[i].dirty = false;
+	bufs[i].data = new char[g_cfg->SectorSize];
+	lru.Append(&bufs[i]);
+    }
+    for (int i = 0; i < DISK_CACHE_HASH; i++)
+	buckets[i] = new IntrusiveList<buf_c>(&buf_c::hashHook);
+    numDirty = 0;
+    flusherWakeUp = NULL;
+    flusherIdle = false;
+    numHits = numMisses = numWrites = numWriteBacks = 0;
 }
 
 //----------------------------------------------------------------------
 // DriverDisk::~DriverDisk
 /*! 	Destructor.
-//      De-allocate data structures needed for the disk driver.
+//      De-allocate data structures needed for the disk driver. Dirty
+//	sectors still in the cache are lost: see Sync.
 */
 //----------------------------------------------------------------------
 
 DriverDisk::~DriverDisk()
 {
+    for (int i = 0; i < DISK_CACHE_HASH; i++)
+	delete buckets[i];
+    for (int i = 0; i < cacheSize; i++)
+	delete [] bufs[i].data;
+    delete [] bufs;
+    // NB: flusherWakeUp is not deleted, the flusher is still waiting on it
     delete lock;
     delete semaphore;
 }
 
+//----------------------------------------------------------------------
+// DriverDisk::WriteBack
+/*! 	Write a dirty buffer to its sector. The lock must be held.
+//
+//	\param buf the buffer to write
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::WriteBack(buf_c *buf)
+{
+    ASSERT(buf->dirty);
+    disk->WriteRequest(buf->sector, buf->data);
+    semaphore->P();			// wait for interrupt
+    buf->dirty = false;
+    numDirty--;
+    numWriteBacks++;
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::GetBuffer
+/*! 	Find the buffer of a sector in the cache, or else reuse the
+//	least recently used buffer for it, after writing it back if it
+//	is dirty. The buffer becomes the most recently used. The lock
+//	must be held.
+//
+//	\param sectorNumber the sector wanted
+//	\param fill true to read the sector from the disk on a miss,
+//	       false when it is about to be overwritten entirely
+//	\return the buffer of the sector
+*/
+//----------------------------------------------------------------------
+
+DriverDisk::buf_c *
+DriverDisk::GetBuffer(int sectorNumber, bool fill)
+{
+    IntrusiveList<buf_c> *bucket = buckets[sectorNumber % DISK_CACHE_HASH];
+    buf_c *buf;
+
+    for (buf = bucket->getFirst(); buf != NULL; buf = bucket->getNext(buf))
+	if (buf->sector == sectorNumber)
+	    break;
+
+    if (buf == NULL) {
+	buf = lru.getFirst();
+	if (buf->dirty)
+	    WriteBack(buf);
+	if (buf->sector != -1)
+	    buckets[buf->sector % DISK_CACHE_HASH]->RemoveItem(buf);
+	buf->sector = sectorNumber;
+	bucket->Append(buf);
+	if (fill) {
+	    disk->ReadRequest(sectorNumber, buf->data);
+	    semaphore->P();		// wait for interrupt
+	    numMisses++;
+	}
+    } else if (fill)
+	numHits++;
+
+    lru.RemoveItem(buf);
+    lru.Append(buf);
+    return buf;
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::Transfer
+/*! 	Read or write a sector, through the buffer cache if there is
+//	one. A write only updates the cache, and wakes the flusher up
+//	if the cache was clean. The lock must be held.
+//
+//	\param sectorNumber the disk sector to transfer
+//	\param data the buffer holding the contents of the sector
+//	\param writing true to write the sector, false to read it
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::Transfer(int sectorNumber, char* data, bool writing)
+{
+    if (cacheSize == 0) {
+	if (writing)
+	    disk->WriteRequest(sectorNumber, data);
+	else
+	    disk->ReadRequest(sectorNumber, data);
+	semaphore->P();			// wait for interrupt
+	return;
+    }
+
+    buf_c *buf = GetBuffer(sectorNumber, !writing);
+    if (!writing) {
+	memcpy(data, buf->data, g_cfg->SectorSize);
+	return;
+    }
+    memcpy(buf->data, data, g_cfg->SectorSize);
+    numWrites++;
+    if (!buf->dirty) {
+	buf->dirty = true;
+	numDirty++;
+	if (flusherIdle) {
+	    flusherIdle = false;
+	    flusherWakeUp->V();
+	}
+    }
+}
+
 //----------------------------------------------------------------------
 // DriverDisk::ReadSector
 /*! 	Read the contents of a disk sector into a buffer. Return only
@@ -85,10 +226,8 @@ DriverDisk::ReadSector(int sectorNumber, char* data)
 {
     DEBUG('d', (char*)"[sdisk] rd req\n");
     lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    DEBUG('d', (char*)"[sdisk] rd req: wait irq\n");
-    semaphore->P();			// wait for interrupt
-    DEBUG('d', (char*)"[sdisk] rd req: wait irq OK\n");
+    Transfer(sectorNumber, data, false);
+    DEBUG('d', (char*)"[sdisk] rd req OK\n");
     lock->Release();
 }
 
@@ -107,10 +246,52 @@ DriverDisk::WriteSector(int sectorNumber, char* data)
 {
     DEBUG('d', (char*)"[sdisk] wr req\n");
     lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    DEBUG('d', (char*)"[sdisk] wr req: wait irq...\n");
-    semaphore->P();			// wait for interrupt
-    DEBUG('d', (char*)"[sdisk] wr req: wait irq OK\n");
+    Transfer(sectorNumber, data, true);
+    DEBUG('d', (char*)"[sdisk] wr req OK\n");
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::ReadSectors
+/*! 	Read consecutive disk sectors into separate buffers (scattered
+//	read). The disk is kept for the whole transfer, so that no other
+//	request moves the head away: after the first sector, each one
+//	comes from the track buffer or right under the head.
+//
+//	\param firstSector the first disk sector to read
+//	\param count the number of sectors to read
+//	\param data the count buffers to hold the contents of the sectors
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::ReadSectors(int firstSector, int count, char** data)
+{
+    DEBUG('d', (char*)"[sdisk] rd req %d sectors\n", count);
+    lock->Acquire();			// only one disk I/O at a time
+    for (int i = 0; i < count; i++)
+	Transfer(firstSector + i, data[i], false);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::WriteSectors
+/*! 	Write a buffer into consecutive disk sectors, with no other
+//	request in between.
+//
+//	\param firstSector the first disk sector to be written
+//	\param count the number of sectors to be written
+//	\param data the new contents of the sectors
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::WriteSectors(int firstSector, int count, char* data)
+{
+    DEBUG('d', (char*)"[sdisk] wr req %d sectors\n", count);
+    lock->Acquire();			// only one disk I/O at a time
+    for (int i = 0; i < count; i++)
+	Transfer(firstSector + i, data + i * g_cfg->SectorSize, true);
     lock->Release();
 }
 
@@ -127,3 +308,91 @@ DriverDisk::RequestDone()
   DEBUG('d', (char*)"[sdisk] req done\n");
   semaphore->V();
 }
+
+//----------------------------------------------------------------------
+// DriverDisk::Sync
+/*! 	Write back all the dirty sectors of the cache. The lock is
+//	released between two sectors, so that cache hits are not delayed
+//	by the whole flush. Called by the flusher and before halting.
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::Sync()
+{
+    for (int i = 0; i < cacheSize; i++) {
+	lock->Acquire();
+	if (bufs[i].dirty)
+	    WriteBack(&bufs[i]);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskFlusher
+/*! 	Entry point of the flusher kernel thread.
+//
+//	\param arg is the DriverDisk
+*/
+//----------------------------------------------------------------------
+
+static void DiskFlusher(int64_t arg)
+{
+    ((DriverDisk *)arg)->RunFlusher();
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::StartFlusher
+/*! 	Start the flusher kernel thread, if the driver has a cache.
+//
+//	\param owner is the process the flusher is attached to
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::StartFlusher(Process *owner)
+{
+    if (cacheSize == 0)
+	return;
+    flusherWakeUp = new Semaphore((char *)"disk flusher", 0);
+    Thread *t = new Thread((char *)"disk flusher");
+    t->StartKernel(owner, DiskFlusher, (int64_t)this);
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::RunFlusher
+/*! 	Body of the flusher. Once a sector is dirtied, it waits for
+//	FLUSH_DELAY ticks, so that the writes that follow are gathered,
+//	and writes all the dirty sectors back. It then sleeps, without
+//	any pending alarm, until the next write to a clean cache. An
+//	idle machine thus halts only once the cache is clean.
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::RunFlusher()
+{
+    for (;;) {
+	if (numDirty == 0) {
+	    flusherIdle = true;
+	    flusherWakeUp->P();
+	}
+	flusherWakeUp->PTimed(FLUSH_DELAY);
+	Sync();
+    }
+}
+
+//----------------------------------------------------------------------
+// DriverDisk::PrintStats
+/*! 	Print the statistics of the buffer cache, if any.
+*/
+//----------------------------------------------------------------------
+
+void
+DriverDisk::PrintStats()
+{
+    if (cacheSize == 0)
+	return;
+    printf("   Disk cache : %d read hits, %d read misses, %d writes, "
+	   "%d written back\n", numHits, numMisses, numWrites, numWriteBacks);
+}
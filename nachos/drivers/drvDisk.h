@@ -14,9 +14,18 @@
 
 #include "machine/disk.h"
 #include "kernel/synch.h"
+#include "utility/intrusivelist.h"
 
 class Semaphore;
 class Lock;
+class Process;
+
+//! Number of buckets of the hash table of the buffer cache
+#define DISK_CACHE_HASH 64
+
+//! Delay between the first write to a clean cache and its write-back,
+//! in ticks
+#define FLUSH_DELAY 10000
 
 /*! \brief Defines a "synchronous" disk abstraction.
 //
@@ -30,12 +39,21 @@ class Lock;
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// The driver may keep a buffer cache of the most recently used
+// sectors, found through a hash table on the sector number and
+// replaced in LRU order. Writes only update the cache: dirty sectors
+// are written back by a flusher kernel thread, FLUSH_DELAY ticks
+// after the first write to a clean cache, when they are replaced, or
+// by Sync.
 */
 class DriverDisk {
   public:
-  DriverDisk(const char* sem_name, const char* lock_name, Disk* theDisk);
+  DriverDisk(const char* sem_name, const char* lock_name, Disk* theDisk,
+	     int cacheSectors = 0);
                                         // Constructor. Initializes the disk
-                                        // driver by initializing the raw Disk.
+                                        // driver by initializing the raw Disk,
+					// with a cache of cacheSectors sectors.
     ~DriverDisk();			// Destructor. De-allocate the driver data
     
     void ReadSector(int sectorNumber, char* data);
@@ -43,18 +61,60 @@ class DriverDisk {
     					// only once the data is actually read 
 					// or written.  
     void WriteSector(int sectorNumber, char* data);
+
+    void WriteSectors(int firstSector, int count, char* data);
+    					// Write consecutive sectors
+					// with no other request in between
+    void ReadSectors(int firstSector, int count, char** data);
+    					// Read consecutive sectors into
+					// separate buffers
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    void StartFlusher(Process *owner);	// Start the flusher kernel thread
+    void RunFlusher();			// Body of the flusher (never returns)
+    void Sync();			// Write back all the dirty sectors
+    void PrintStats();			// Print the statistics of the cache
+
 private:
+  /*! A sector held in the buffer cache */
+  struct buf_c {
+    int sector;				//!< Sector held, -1 if none
+    bool dirty;				//!< true if not written back yet
+    char *data;				//!< Contents of the sector
+    ListHook<buf_c> lruHook;		//!< Links in lru
+    ListHook<buf_c> hashHook;		//!< Links in the hash bucket
+  };
+
+  void Transfer(int sectorNumber, char* data, bool writing);
+					// Read or write a sector, through
+					// the cache if any (lock held)
+  buf_c *GetBuffer(int sectorNumber, bool fill);
+					// Find or load the buffer of a sector
+  void WriteBack(buf_c *buf);		// Write a dirty buffer to the disk
+
+
   Semaphore *semaphore; 		/*!< To synchronize requesting thread 
 					     with the interrupt handler
 					*/
   Lock *lock;		  		/*!< Mutual exclusion on the disk device
 					*/
   Disk *disk;                         /* The disk */
+
+  int cacheSize;			//!< Number of buffers, 0 if no cache
+  buf_c *bufs;				//!< The buffers of the cache
+  IntrusiveList<buf_c> lru;		//!< Buffers, least recently used first
+  IntrusiveList<buf_c> *buckets[DISK_CACHE_HASH]; //!< Buffers by sector
+  int numDirty;				//!< Number of dirty buffers
+  Semaphore *flusherWakeUp;		//!< The flusher sleeps on it when idle
+  bool flusherIdle;			//!< true if the flusher waits on it
+
+  int numHits;				//!< Sectors read from the cache
+  int numMisses;			//!< Sectors read from the disk
+  int numWrites;			//!< Sectors written to the cache
+  int numWriteBacks;			//!< Dirty sectors written to the disk
 };
 
 void DiskRequestDone();
@@ -54,7 +54,9 @@
 #include "filesys/directory.h"
 #include "filesys/filehdr.h"
 #include "filesys/filesys.h"
+#include "filesys/namecache.h"
 #include "filesys/oftable.h"
+#include "vm/physMem.h"
 
 /*! Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -96,11 +98,49 @@ bool decompname (const char * orig_path, char * head, char * tail)
     memmove(tail, orig_path, strlen(tail));
     return false;
   } else {
-    strcpy(tail, path);
+    memmove(tail, path, strlen(path) + 1); // may overlap, unlike strcpy
     return true;
   }
 }
 
+//----------------------------------------------------------------------
+// FindEntry
+/*!
+//  Look up an entry of a directory, in the name cache or else on
+//  disk. In the latter case, the directory and the header of the
+//  entry are fetched, and the result is entered in the cache.
+//
+//   \param dirsector the sector of the header of the directory
+//   \param name the name of the entry (NOT MODIFIED)
+//   \param isDir where to store whether the entry is a directory
+//   \return the sector of the header of the entry, or -1 if the
+//     directory has no such entry
+*/
+//----------------------------------------------------------------------
+int FindEntry(int dirsector, char *name, bool *isDir)
+{
+  NameCache *cache = g_file_system->GetNameCache();
+  int sector;
+
+  if (cache->Lookup(dirsector, name, &sector, isDir))
+    return sector;
+
+  // Fetching may block: the cache tells if it was invalidated meanwhile
+  unsigned version = cache->Stamp();
+  OpenFile dirfile(dirsector);
+  Directory directory(g_cfg->NumDirEntries);
+  directory.FetchFrom(&dirfile);
+  sector = directory.Find(name);
+  *isDir = false;
+  if (sector >= 0) {
+    FileHeader hdr;
+    hdr.FetchFrom(sector);
+    *isDir = hdr.IsDir();
+  }
+  cache->Enter(dirsector, name, sector, *isDir, version);
+  return sector;
+}
+
 //----------------------------------------------------------------------
 // FindDir
 /*!
@@ -112,8 +152,8 @@ bool decompname (const char * orig_path, char * head, char * tail)
 //  FindDir("/bin/halt") then name is "halt" after the execution, the
 //  function returns the sector number of the directory "/bin").
 //
-//  Actually, this function does not support complete pathnames
-//  This is one of the objectives of the file system assignment
+//  Each component is first looked for in the name cache, so that
+//  the directories of a path already resolved are not fetched again.
 //
 //   \param name is the complete name (relatively to the root
 //     directory). The contents of this string will be modified!
@@ -125,25 +165,19 @@ int FindDir(char *name)
 {
   DEBUG('f', (char*)"FindDir [%s]\n", name);
 
-  // Fetch the root directory from disk
-  Directory directory(g_cfg->NumDirEntries);
-  directory.FetchFrom(g_file_system->GetDirFile());
-
   // Start the search in the root directory
   int sector = DirectorySector;
   char dirname[g_cfg->MaxFileNameSize];
   while(decompname(name, dirname, name)) {
+    bool isDir;
 
     // Get the sector of the file/directory corresponding to 'name'
-    sector = directory.Find(dirname);
+    sector = FindEntry(sector, dirname, &isDir);
     if (sector < 0)
       return -1; // This file/directory does not exist ...
 
     // Check that it is a directory
-    OpenFile file(sector);
-    if(file.GetFileHeader()->IsDir())
-      directory.FetchFrom(&file);
-    else
+    if (!isDir)
       return -1;
   }
 
@@ -167,6 +201,7 @@ int FindDir(char *name)
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', (char*)"Initializing the file system.\n");
+    nameCache = new NameCache();
     if (format) {
         BitMap freeMap(NUM_SECTORS);
         Directory directory(g_cfg->NumDirEntries);
@@ -236,6 +271,7 @@ FileSystem::~FileSystem()
 { 
   delete freeMapFile;
   delete directoryFile;
+  delete nameCache;
 }
 
 //----------------------------------------------------------------------
@@ -304,6 +340,7 @@ FileSystem::Create(char *name, int initialSize)
     }
 
     // Add the file in the directory
+    nameCache->Invalidate(dirsector, dirname);
     int add_result = directory.Add(dirname, sector);
     if (add_result != NoError) {
       g_open_file_table->createLock->Release();
@@ -325,6 +362,9 @@ FileSystem::Create(char *name, int initialSize)
     directory.WriteBack(&dirfile);      // Directory
     freeMap.WriteBack(freeMapFile);     // Freemap
 
+    // Drop a lookup made on the old directory while it was written
+    nameCache->Invalidate(dirsector, dirname);
+
     DEBUG('f', (char*)"END Creating file %s, size %d\n", name, initialSize);
     g_open_file_table->createLock->Release();
     return NoError;
@@ -352,23 +392,15 @@ FileSystem::Open(char *name)
   dirsector=FindDir(dirname);
   if (dirsector == -1) return NULL;
 
-  // Read the directory from disk
-  OpenFile dirfile(dirsector);
   DEBUG('f', (char*)"Opening file %s\n", name);
-  Directory directory(g_cfg->NumDirEntries);
-  directory.FetchFrom(&dirfile);
 
   // Find the file in the directory
-  sector = directory.Find(dirname); 
-  if (sector >= 0)
+  bool isDir;
+  sector = FindEntry(dirsector, dirname, &isDir);
+  if (sector >= 0 && !isDir)
     { 		
     openFile = new OpenFile(sector);	// name was found in directory 
     openFile->SetName(name);
-    if (openFile->IsDir())
-      {
-	delete openFile;
-	return NULL;
-      }
     }
 
   return openFile;	     		// return NULL if not found
@@ -431,13 +463,20 @@ FileSystem::Remove(char *name)
   fileHdr.Deallocate(&freeMap);      	// remove data blocks
   freeMap.Clear(sector);	      	// remove header block
 
+  // The header sector may now be reused by another executable
+  g_physical_mem_manager->UncacheFile(sector);
+
   // Remove the file from the directory
+  nameCache->Invalidate(dirsector, dirname);
   directory.Remove(dirname);
   
   // Flush everything to disk
   freeMap.WriteBack(freeMapFile);    	// freemap
   directory.WriteBack(&dirfile);        // directory
 
+  // Drop a lookup made on the old directory while it was written
+  nameCache->Invalidate(dirsector, dirname);
+
   return NoError;
 } 
 
@@ -513,6 +552,16 @@ OpenFile *FileSystem::GetDirFile(){
   return directoryFile;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::GetNameCache()
+/*!    return the cache of path name lookups (used by FindDir and by
+//     the open file table).
+*/
+//----------------------------------------------------------------------
+NameCache *FileSystem::GetNameCache(){
+  return nameCache;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::mkdir
 /*! 	Create a directory in the Nachos file system (similar to UNIX create).
@@ -571,6 +620,7 @@ FileSystem::Mkdir(char *dirname)
     return OutOfDisk; // no space on disk for data
 
   // Add the directory in the parent directory
+  nameCache->Invalidate(parentsect, name);
   int add_result = parentdir.Add(name, hdr_sect);
   if (add_result != NoError)
     return add_result;  
@@ -592,6 +642,9 @@ FileSystem::Mkdir(char *dirname)
   parentdir.WriteBack(&parentdirfile);
   freeMap.WriteBack(freeMapFile);
 
+  // Drop a lookup made on the old parent directory while it was written
+  nameCache->Invalidate(parentsect, name);
+
   return NoError;  
 }
 
@@ -661,13 +714,21 @@ FileSystem::Rmdir(char *dirname)
   // Deallocate the sector containing the directory header
   freeMap.Clear(thedirsect);
 
-  // We remove the directory from its parent directory
+  // We remove the directory from its parent directory, and forget
+  // the (negative) lookups made in it
+  nameCache->Invalidate(parentsect, name);
+  nameCache->Purge(thedirsect);
   parentdir.Remove(name);
  
   // Flush everything to disk
   freeMap.WriteBack(freeMapFile);         // freemap
   parentdir.WriteBack(&parentdirfile);    // parent directory
 
+  // Drop the lookups made on the old directories while they were
+  // written
+  nameCache->Invalidate(parentsect, name);
+  nameCache->Purge(thedirsect);
+
   return NoError;
 }
 
@@ -36,7 +36,10 @@
 #include "kernel/copyright.h"
 #include "filesys/openfile.h"
 
+class NameCache;
+
 int FindDir(char *);
+int FindEntry(int dirsector, char *name, bool *isDir);
 /*! \brief Defines the Nachos file system
  */
 class FileSystem {
@@ -61,6 +64,8 @@ class FileSystem {
     
     OpenFile *GetDirFile();             //!< Get the root directory
 
+    NameCache *GetNameCache();          //!< Get the cache of name lookups
+
     int Mkdir(char *);                  //!< Create a new directory
     
     int Rmdir(char *);                  //!< Delete a directory
@@ -73,6 +78,7 @@ class FileSystem {
    OpenFile* directoryFile;		/*!< "Root" directory -- list of 
 					 file names, represented as a file
 					 */
+   NameCache* nameCache;		//!< Cache of path name lookups
 };
 
 #endif // FS_H
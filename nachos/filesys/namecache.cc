@@ -0,0 +1,225 @@
+/*! \file namecache.cc
+//  \brief Routines of the cache of path name lookups
+//
+//  The cache holds a fixed number of lookups, replaced in LRU order,
+//  and found through a hash table on (directory sector, name). Names
+//  longer than the names of the directory entries are never cached.
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.
+//  See copyright_insa.h for copyright notice and limitation
+//  of liability and disclaimer of warranty provisions.
+*/
+
+#include <string.h>
+
+#include "kernel/system.h"
+#include "filesys/namecache.h"
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+/*! 	Initialize an empty cache.
+*/
+//----------------------------------------------------------------------
+NameCache::NameCache()
+  : lru(&name_c::lruHook)
+{
+  entries = new name_c[NAME_CACHE_SIZE];
+  for (int i = 0; i < NAME_CACHE_SIZE; i++) {
+    entries[i].parent = -1;
+    lru.Append(&entries[i]);
+  }
+  for (int i = 0; i < NAME_CACHE_HASH; i++)
+    buckets[i] = new IntrusiveList<name_c>(&name_c::hashHook);
+  stamp = 0;
+  numHits = numNegativeHits = numMisses = 0;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+/*! 	De-allocate the cache.
+*/
+//----------------------------------------------------------------------
+NameCache::~NameCache()
+{
+  for (int i = 0; i < NAME_CACHE_HASH; i++)
+    delete buckets[i];
+  delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Bucket
+/*! 	Return the hash bucket of the lookups of a name in a directory.
+//
+//	\param parent the sector of the header of the directory
+//	\param name the name of the entry
+*/
+//----------------------------------------------------------------------
+IntrusiveList<NameCache::name_c> *
+NameCache::Bucket(int parent, const char *name)
+{
+  uint32_t h = (uint32_t)parent;
+
+  for (const char *c = name; *c != '\0'; c++)
+    h = h * 31 + (unsigned char)*c;
+  return buckets[h % NAME_CACHE_HASH];
+}
+
+//----------------------------------------------------------------------
+// NameCache::Find
+/*! 	Find the lookup of a name in a directory.
+//
+//	\param parent the sector of the header of the directory
+//	\param name the name of the entry
+//	\return the lookup, NULL if it is not in the cache
+*/
+//----------------------------------------------------------------------
+NameCache::name_c *
+NameCache::Find(int parent, const char *name)
+{
+  IntrusiveList<name_c> *bucket = Bucket(parent, name);
+
+  for (name_c *n = bucket->getFirst(); n != NULL; n = bucket->getNext(n))
+    if (n->parent == parent && strcmp(n->name, name) == 0)
+      return n;
+  return NULL;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Remove
+/*! 	Remove a lookup from the cache. Its slot becomes the first to
+//	be reused.
+*/
+//----------------------------------------------------------------------
+void
+NameCache::Remove(name_c *n)
+{
+  Bucket(n->parent, n->name)->RemoveItem(n);
+  n->parent = -1;
+  lru.RemoveItem(n);
+  lru.Prepend(n);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Lookup
+/*! 	Look for the entry name of a directory in the cache. The lookup
+//	becomes the most recently used.
+//
+//	\param parent the sector of the header of the directory
+//	\param name the name of the entry
+//	\param sector where to store the sector of the header of the
+//	       entry, -1 if the directory has no such entry
+//	\param isDir where to store whether the entry is a directory
+//	\return true if the lookup was in the cache, false if it must be
+//	       made on disk
+*/
+//----------------------------------------------------------------------
+bool
+NameCache::Lookup(int parent, const char *name, int *sector, bool *isDir)
+{
+  name_c *n = NULL;
+
+  if (strlen(name) <= FILENAMEMAXLEN)
+    n = Find(parent, name);
+  if (n == NULL) {
+    numMisses++;
+    return false;
+  }
+
+  *sector = n->sector;
+  *isDir = n->isDir;
+  numHits++;
+  if (n->sector == -1)
+    numNegativeHits++;
+  lru.RemoveItem(n);
+  lru.Append(n);
+  return true;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+/*! 	Remember the result of a lookup made on disk, in place of the
+//	least recently used one. As fetching the directory may have
+//	blocked, the directory may have been modified meanwhile: the
+//	result is dropped if the cache was invalidated since version.
+//
+//	\param parent the sector of the header of the directory
+//	\param name the name of the entry
+//	\param sector the sector of the header of the entry, -1 if the
+//	       directory has no such entry
+//	\param isDir true if the entry is a directory
+//	\param version the result of Stamp before the lookup on disk
+*/
+//----------------------------------------------------------------------
+void
+NameCache::Enter(int parent, const char *name, int sector, bool isDir,
+		 unsigned version)
+{
+  if (version != stamp || strlen(name) > FILENAMEMAXLEN)
+    return;
+
+  name_c *n = Find(parent, name);
+  if (n == NULL) {
+    n = lru.getFirst();
+    if (n->parent != -1)
+      Bucket(n->parent, n->name)->RemoveItem(n);
+    n->parent = parent;
+    strcpy(n->name, name);
+    Bucket(parent, name)->Append(n);
+  }
+  n->sector = sector;
+  n->isDir = isDir;
+  lru.RemoveItem(n);
+  lru.Append(n);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Invalidate
+/*! 	Forget the entry name of a directory, because it is being added
+//	to or removed from the directory. Called before the directory is
+//	modified, and again once it is written back, to drop the lookups
+//	that read the old directory from the disk meanwhile.
+//
+//	\param parent the sector of the header of the directory
+//	\param name the name of the entry
+*/
+//----------------------------------------------------------------------
+void
+NameCache::Invalidate(int parent, const char *name)
+{
+  stamp++;
+  if (strlen(name) > FILENAMEMAXLEN)
+    return;
+  name_c *n = Find(parent, name);
+  if (n != NULL)
+    Remove(n);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Purge
+/*! 	Forget all the entries of a directory, because it is removed:
+//	its sector may be reused by another directory.
+//
+//	\param parent the sector of the header of the directory
+*/
+//----------------------------------------------------------------------
+void
+NameCache::Purge(int parent)
+{
+  stamp++;
+  for (int i = 0; i < NAME_CACHE_SIZE; i++)
+    if (entries[i].parent == parent)
+      Remove(&entries[i]);
+}
+
+//----------------------------------------------------------------------
+// NameCache::PrintStats
+/*! 	Print the statistics of the cache.
+*/
+//----------------------------------------------------------------------
+void
+NameCache::PrintStats()
+{
+  printf("Name cache: %d lookups hit (%d negative), %d made on disk\n",
+	 numHits, numNegativeHits, numMisses);
+}
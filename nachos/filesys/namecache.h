@@ -0,0 +1,97 @@
+/*! \file namecache.h
+    \brief Data structures for the cache of path name lookups
+
+    Resolving a path walks through its directories from the root: for
+    each component, the directory is fetched from the disk and the
+    header of the entry found is read, to check it is a directory.
+    The name cache remembers the result of these lookups, indexed by
+    (sector of the directory, name of the entry), so that the
+    components of a path already resolved need no disk access.
+
+    Names that are not found are cached too (negative entries), as
+    repeated lookups of missing files are frequent (e.g. the shell
+    searching for a program).
+
+    The cache is a hint: an entry must be invalidated each time a
+    directory is modified, by calling Invalidate for the name added or
+    removed, and Purge for a directory removed as a whole. This is
+    done both before the directory is modified and after it is written
+    back: a lookup made on disk in the meantime may have read the old
+    directory.
+
+ Copyright (c) 1999-2000 INSA de Rennes.
+ All rights reserved.
+ See copyright_insa.h for copyright notice and limitation
+ of liability and disclaimer of warranty provisions.
+*/
+
+#ifndef NAMECACHE_H
+#define NAMECACHE_H
+
+#include "kernel/copyright.h"
+#include "filesys/directory.h"
+#include "utility/intrusivelist.h"
+
+//! Number of lookups kept in the name cache
+#define NAME_CACHE_SIZE 64
+
+//! Number of buckets of the hash table of the name cache
+#define NAME_CACHE_HASH 32
+
+/*! \brief Defines the cache of (directory, name) lookups
+*/
+class NameCache {
+public:
+  NameCache();    //!< Build an empty cache
+  ~NameCache();   //!< De-allocate the cache
+
+  //! Look for the entry name of the directory at sector parent
+  bool Lookup(int parent, const char *name, int *sector, bool *isDir);
+
+  //! Version of the cache, to give to Enter after a lookup on disk
+  unsigned Stamp() { return stamp; }
+
+  //! Remember the result of a lookup on disk, unless outdated
+  void Enter(int parent, const char *name, int sector, bool isDir,
+	     unsigned version);
+
+  //! Forget the entry name of the directory at sector parent
+  void Invalidate(int parent, const char *name);
+
+  //! Forget all the entries of the directory at sector parent
+  void Purge(int parent);
+
+  //! Print the statistics of the cache
+  void PrintStats();
+
+private:
+  /*! A lookup held in the cache */
+  struct name_c {
+    int parent;			//!< Sector of the directory, -1 if unused
+    int sector;			//!< Sector of the entry, -1 if not found
+    bool isDir;			//!< true if the entry is a directory
+    char name[FILENAMEMAXLEN + 1]; //!< Name of the entry
+    ListHook<name_c> lruHook;	//!< Links in lru
+    ListHook<name_c> hashHook;	//!< Links in the hash bucket
+  };
+
+  //! Bucket of the lookups of name in the directory at sector parent
+  IntrusiveList<name_c> *Bucket(int parent, const char *name);
+
+  //! Find a lookup in the cache, NULL if absent
+  name_c *Find(int parent, const char *name);
+
+  //! Remove a lookup from the cache
+  void Remove(name_c *n);
+
+  name_c *entries;		//!< The lookups of the cache
+  IntrusiveList<name_c> lru;	//!< Lookups, least recently used first
+  IntrusiveList<name_c> *buckets[NAME_CACHE_HASH]; //!< Lookups by name
+  unsigned stamp;		//!< Incremented by each invalidation
+
+  int numHits;			//!< Lookups found in the cache
+  int numNegativeHits;		//!< Of which for names not found
+  int numMisses;		//!< Lookups made on disk
+};
+
+#endif // NAMECACHE_H
@@ -17,6 +17,7 @@
 #include "utility/bitmap.h"
 #include "filesys/directory.h"
 #include "filesys/filesys.h"
+#include "filesys/namecache.h"
 #include "filesys/oftable.h"
 
 //----------------------------------------------------------
@@ -120,34 +121,23 @@ OpenFile * OpenFileTable::Open(char *name)
      {  
        OpenFileTableEntry *entry = new OpenFileTableEntry;
        OpenFile *openfile = NULL;
-       Directory directory(g_cfg->NumDirEntries);
+       bool isDir;
 
        strcpy(entry->name,name);
        strcpy(filename,name);
 
-       // Find the directory containing the file and read it from the disk
+       // Find the directory containing the file
        dirsector = FindDir(filename);
        if (dirsector == -1) return NULL;
-       OpenFile dirfile(dirsector);
-       directory.FetchFrom(&dirfile);
 
-       // Find the file in the directory
-       sector=directory.Find(filename);
-       if (sector >= 0)
-	 { 		
-	   openfile = new OpenFile(sector);	// name was found in directory 
-	   if (openfile->IsDir())               // name is a directory ...
-	     {
-	       delete openfile;
-	       delete entry;
-	       return NULL;
-	     }
-	 }
-       else                                    // name isn't in directory
-	 {
+       // Find the file in the directory (or in the name cache)
+       sector=FindEntry(dirsector, filename, &isDir);
+       if (sector < 0 || isDir)                // name isn't in directory
+	 {                                     // or is a directory ...
 	   delete entry;
 	   return NULL;
 	 }
+       openfile = new OpenFile(sector);	// name was found in directory 
 
        // We found the file
        newfile = new OpenFile(sector);        // we fill the new entry
@@ -288,8 +278,10 @@ int OpenFileTable::Remove(char *name)
   if (num!=-1)          // file is opened by a thread
     {
       table[num]->ToBeDeleted=true;
+      g_file_system->GetNameCache()->Invalidate(dirsector, filename);
       directory.Remove(filename);
       directory.WriteBack(&dirfile);
+      g_file_system->GetNameCache()->Invalidate(dirsector, filename);
     }
   else                  // file isn't opened
     {
@@ -266,6 +266,16 @@ OpenFile::GetFileHeader()
   return hdr;
 }
 //----------------------------------------------------------------------
+// OpenFile::GetHeaderSector
+//! 	Return the sector of the file's header, which identifies the
+//	file on the disk.
+//----------------------------------------------------------------------
+int
+OpenFile::GetHeaderSector()
+{
+  return fSector;
+}
+//----------------------------------------------------------------------
 // OpenFile::IsDir
 //! 	Return true if the file is a directory.
 //----------------------------------------------------------------------
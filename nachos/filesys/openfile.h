@@ -62,6 +62,8 @@ public:
 					   end of file, tell, lseek back 
 				        */
   FileHeader * GetFileHeader();       //!< return the file's header
+
+  int GetHeaderSector();              //!< return the sector of the file's header
   
   char* GetName();                    //!< return the file's name
   
@@ -27,6 +27,9 @@
 #include "filesys/filehdr.h"
 #include "filesys/openfile.h"
 #include "vm/physMem.h"
+#include "vm/swapManager.h"
+#include "vm/pagewait.h"
+#include "utility/bitmap.h"
 #include "kernel/elf32.h"
 #include "kernel/addrspace.h"
 
@@ -69,6 +72,19 @@ AddrSpace::AddrSpace(OpenFile * exec_file, Process *p, int *err)
   translationTable = NULL;
   freePageId = 0;
   process = p;
+  faultNext = -1;
+  faultWindow = 1;
+  cowPages = new BitMap(g_cfg->MaxVirtPages);
+  mapped_files = NULL;
+  nb_mapped_files = max_mapped_files = 0;
+  heapBase = -1;
+  heapPages = heapBreak = 0;
+  heapLock = new Lock((char *)"heap");
+  free_ranges = NULL;
+  nb_free_ranges = max_free_ranges = 0;
+#ifdef ETUDIANTS_TP
+  g_physical_mem_manager->AddSpace(this, exec_file != NULL);
+#endif
 
   /* Empty user address space requested ? */
   if (exec_file == NULL)
@@ -243,9 +259,105 @@ AddrSpace::AddrSpace(OpenFile * exec_file, Process *p, int *err)
   CodeStartAddress = (int32_t)elfHdr.e_entry;
   printf("\t- Program start address : 0x%lx\n\n",
 	 (unsigned long)CodeStartAddress);
+}
 
-  // Init the number of memory mapped files to zero
-  nb_mapped_files = 0;
+//----------------------------------------------------------------------
+/**   Create a copy of an address space, for a process created by
+ //   Fork. No page is copied: the physical pages and swap sectors
+ //   of the parent are shared, and writable pages become
+ //   copy-on-write in both address spaces (see CopyOnWrite).
+ //
+ //   Processes with memory-mapped files cannot be forked (checked
+ //   by the caller, see Process::Process).
+ //
+ //   \param parent: the address space to copy
+ //   \param process: process of the new address space
+ //   \param err: error code NoError if OK
+ */
+//----------------------------------------------------------------------
+AddrSpace::AddrSpace(AddrSpace *parent, Process *p, int *err)
+{
+  *err = NoError;
+  translationTable = NULL;
+  freePageId = 0;
+  process = p;
+  faultNext = -1;
+  faultWindow = 1;
+  cowPages = new BitMap(g_cfg->MaxVirtPages);
+  mapped_files = NULL;
+  nb_mapped_files = max_mapped_files = 0;
+  heapBase = parent->heapBase;
+  heapPages = parent->heapPages;
+  heapBreak = parent->heapBreak;
+  heapLock = new Lock((char *)"heap");
+  free_ranges = NULL;
+  nb_free_ranges = max_free_ranges = 0;
+#ifdef ETUDIANTS_TP
+  g_physical_mem_manager->AddSpace(this, parent->counted);
+#endif
+  CodeStartAddress = parent->CodeStartAddress;
+
+#ifndef ETUDIANTS_TP
+  printf("**** Warning: Fork is not implemented yet\n");
+  exit(-1);
+#else
+  ASSERT(parent->nb_mapped_files == 0);
+
+  translationTable = new TranslationTable();
+  freePageId = parent->freePageId;
+  TranslationTable *ptt = parent->translationTable;
+  if (parent->nb_free_ranges > 0) {
+    max_free_ranges = parent->max_free_ranges;
+    nb_free_ranges = parent->nb_free_ranges;
+    free_ranges = new s_vrange[max_free_ranges];
+    for (int k = 0; k < nb_free_ranges; k++)
+      free_ranges[k] = parent->free_ranges[k];
+  }
+
+  for (int i = 0; i < freePageId; i++) {
+    // Wait for the page faults, evictions and write-backs in progress
+    parent->WaitPage(i);
+
+    translationTable->clearBitIo(i);
+    translationTable->clearBitU(i);
+    if (ptt->getBitReadAllowed(i))
+      translationTable->setBitReadAllowed(i);
+    else
+      translationTable->clearBitReadAllowed(i);
+    translationTable->setAddrDisk(i, ptt->getAddrDisk(i));
+    if (ptt->getBitSwap(i)) {
+      ASSERT(ptt->getAddrDisk(i) >= 0);
+      translationTable->setBitSwap(i);
+      g_swap_manager->SharePageSwap(ptt->getAddrDisk(i));
+    } else
+      translationTable->clearBitSwap(i);
+
+    // Writable pages become copy-on-write in both address spaces
+    if (ptt->getBitWriteAllowed(i) || parent->cowPages->Test(i)) {
+      ptt->clearBitWriteAllowed(i);
+      parent->cowPages->Mark(i);
+      cowPages->Mark(i);
+    }
+    translationTable->clearBitWriteAllowed(i);
+
+    // Share the physical page. It stays dirty in both address spaces
+    // if the parent modified it, as it differs from the disk copy
+    if (ptt->getBitValid(i)) {
+      int pp = ptt->getPhysicalPage(i);
+      translationTable->setPhysicalPage(i, pp);
+      if (ptt->getBitM(i))
+	translationTable->setBitM(i);
+      else
+	translationTable->clearBitM(i);
+      translationTable->setBitValid(i);
+      if (!g_physical_mem_manager->IsZeroPage(pp))
+	g_physical_mem_manager->ShareMapping(pp, this, i);
+    } else {
+      translationTable->clearBitM(i);
+      translationTable->clearBitValid(i);
+    }
+  }
+#endif
 }
 
 //----------------------------------------------------------------------
@@ -261,6 +373,12 @@ AddrSpace::~AddrSpace()
     
     // For every virtual page
     for (i = 0 ; i <  freePageId ; i++) {
+
+#ifdef ETUDIANTS_TP
+      // Wait for the eviction of the page, or for the page cleaner
+      // writing it back
+      WaitPage(i);
+#endif
       
       // If it is in physical memory, free the physical page
       if (translationTable->getBitValid(i)) {
@@ -278,7 +396,13 @@ AddrSpace::~AddrSpace()
 	}
 #endif
 
-	g_physical_mem_manager->RemovePhysicalToVirtualMapping(translationTable->getPhysicalPage(i));
+#ifdef ETUDIANTS_TP
+	if (g_physical_mem_manager->IsZeroPage(translationTable->getPhysicalPage(i)))
+	  translationTable->clearBitValid(i);
+	else
+#endif
+	g_physical_mem_manager->UnmapPage(translationTable->getPhysicalPage(i),
+					  this, i);
       }
 
       // If it is in the swap disk, free the corresponding disk sector
@@ -296,13 +420,21 @@ AddrSpace::~AddrSpace()
 // #endif
     delete translationTable;
   }
+  delete cowPages;
+  delete[] mapped_files;
+  delete[] free_ranges;
+  delete heapLock;
+#ifdef ETUDIANTS_TP
+  g_physical_mem_manager->RemoveSpace(this);
+#endif
 }
 
 //----------------------------------------------------------------------
 /**	Allocates a new stack of size g_cfg->UserStackSize
  *
- *      Allocation is done by calling Alloc, a very simple
- *      allocation procedure of virtual memory areas.
+ *      Allocation is done by calling Alloc, together with the blank
+ *      space below the stack, so that StackRelease finds both from
+ *      the stack pointer.
  *
  *      \return stack pointer (at the end of the allocated stack)
  */
@@ -312,17 +444,21 @@ int AddrSpace::StackAllocate(void)
   // Optional : leave an anmapped blank space below the stack to
   // detect stack overflows
 #define STACK_BLANK_LEN 4 // in pages
-  int blankaddr = this->Alloc(STACK_BLANK_LEN);
-  DEBUG('a', (char*)"Allocated unmapped virtual area [0x%x,0x%x[ for stack overflow detection\n",
-	blankaddr*g_cfg->PageSize, (blankaddr+STACK_BLANK_LEN)*g_cfg->PageSize);
 
   // The new stack parameters
   int stackBasePage, numPages;
   numPages = divRoundUp(g_cfg->UserStackSize, g_cfg->PageSize);
 
-  // Allocate virtual space for the new stack
-  stackBasePage = this->Alloc(numPages);
-  ASSERT (stackBasePage >= 0);
+  // Allocate virtual space for the new stack and its blank space
+  int blankPage = this->Alloc(STACK_BLANK_LEN + numPages);
+  ASSERT (blankPage >= 0);
+  for (int i = blankPage ; i < blankPage + STACK_BLANK_LEN ; i++) {
+    translationTable->clearBitReadAllowed(i);
+    translationTable->clearBitWriteAllowed(i);
+  }
+  DEBUG('a', (char*)"Allocated unmapped virtual area [0x%x,0x%x[ for stack overflow detection\n",
+	blankPage*g_cfg->PageSize, (blankPage+STACK_BLANK_LEN)*g_cfg->PageSize);
+  stackBasePage = blankPage + STACK_BLANK_LEN;
   DEBUG('a', (char*)"Allocated virtual area [0x%x,0x%x[ for stack\n",
 	stackBasePage*g_cfg->PageSize,
 	(stackBasePage+numPages)*g_cfg->PageSize);
@@ -368,7 +504,172 @@ int AddrSpace::StackAllocate(void)
 }
 
 //----------------------------------------------------------------------
-/**  Allocate numPages virtual pages in the current address space
+/**	Release the stack of a finishing thread, and the blank space
+ *      below it. The thread must not use its user stack any more.
+ *
+ *      \param stackPointer the stack pointer returned by StackAllocate
+ */
+//----------------------------------------------------------------------
+void AddrSpace::StackRelease(int stackPointer)
+{
+  int numPages = divRoundUp(g_cfg->UserStackSize, g_cfg->PageSize);
+  int endPage = (stackPointer + 4*sizeof(int)) / g_cfg->PageSize;
+  int blankPage = endPage - numPages - STACK_BLANK_LEN;
+
+  DEBUG('a', (char*)"Released stack area [0x%x,0x%x[\n",
+	blankPage*g_cfg->PageSize, endPage*g_cfg->PageSize);
+#ifdef ETUDIANTS_TP
+  ReleasePages(blankPage, endPage - blankPage);
+#endif
+  Free(blankPage, endPage - blankPage);
+}
+
+//----------------------------------------------------------------------
+/**	Allocates size bytes of zero-filled virtual memory (rounded up
+ *      to a whole number of pages), for use by the kernel on behalf
+ *      of the process. As for stacks, pages are only given a physical
+ *      page, filled with zeroes, on their first access.
+ *
+ *      \return the virtual address of the area, -1 if there is
+ *      not enough virtual space
+ */
+//----------------------------------------------------------------------
+int AddrSpace::AnonAllocate(int size)
+{
+#ifndef ETUDIANTS_TP
+  printf("**** Warning: method AddrSpace::AnonAllocate is not implemented yet\n");
+  exit(-1);
+#else
+  int numPages = divRoundUp(size, g_cfg->PageSize);
+  int basePage = this->Alloc(numPages);
+  if (basePage < 0)
+    return -1;
+  DEBUG('a', (char*)"Allocated anonymous virtual area [0x%x,0x%x[\n",
+	basePage*g_cfg->PageSize, (basePage+numPages)*g_cfg->PageSize);
+
+  for (int i = basePage ; i < basePage + numPages ; i++) {
+    translationTable->clearBitValid(i);
+    translationTable->setAddrDisk(i, -1);
+    translationTable->clearBitSwap(i);
+    translationTable->setBitReadAllowed(i);
+    translationTable->setBitWriteAllowed(i);
+    translationTable->clearBitIo(i);
+  }
+  return basePage * g_cfg->PageSize;
+#endif
+}
+
+//----------------------------------------------------------------------
+/**	Move the end of the heap (the break) by increment bytes.
+ *
+ *      At the first call, a quarter of the virtual pages still free
+ *      is reserved for the heap, with no access allowed. Growing the
+ *      heap allows the access to the pages under the new break, as
+ *      demand-zero pages (see AnonAllocate); shrinking it frees the
+ *      physical pages and swap sectors of the pages left entirely
+ *      above the break, and forbids their access again.
+ *
+ *      Calls are serialized by heapLock, as freeing pages may wait
+ *      for the I/O in progress on them.
+ *
+ *      \param increment is the number of bytes to add to the heap
+ *      (negative to shrink it)
+ *      \return the previous break, -1 if the heap cannot grow or
+ *      shrink that much
+ */
+//----------------------------------------------------------------------
+int AddrSpace::Sbrk(int increment)
+{
+#ifndef ETUDIANTS_TP
+  printf("**** Warning: method AddrSpace::Sbrk is not implemented yet\n");
+  exit(-1);
+#else
+  TranslationTable *tt = translationTable;
+  int pageSize = g_cfg->PageSize;
+
+  heapLock->Acquire();
+  if (heapBase == -1) {
+    int numPages = (tt->getMaxNumPages() - freePageId) / 4;
+    int basePage = Alloc(numPages);
+    if (basePage < 0) {
+      heapLock->Release();
+      return -1;
+    }
+    DEBUG('a', (char*)"Reserved virtual area [0x%x,0x%x[ for the heap\n",
+	  basePage*pageSize, (basePage+numPages)*pageSize);
+    heapBase = basePage;
+    heapPages = numPages;
+    heapBreak = basePage * pageSize;
+  }
+
+  int oldBreak = heapBreak;
+  int64_t newBreak = (int64_t)heapBreak + increment;
+  if (newBreak < (int64_t)heapBase * pageSize
+      || newBreak > (int64_t)(heapBase + heapPages) * pageSize) {
+    heapLock->Release();
+    return -1;
+  }
+  heapBreak = newBreak;
+
+  int oldEnd = divRoundUp(oldBreak, pageSize);
+  int newEnd = divRoundUp(heapBreak, pageSize);
+
+  // New demand-zero pages
+  for (int i = oldEnd; i < newEnd; i++) {
+    tt->clearBitValid(i);
+    tt->setAddrDisk(i, -1);
+    tt->clearBitSwap(i);
+    tt->setBitReadAllowed(i);
+    tt->setBitWriteAllowed(i);
+    tt->clearBitIo(i);
+  }
+
+  // Pages released
+  if (newEnd < oldEnd)
+    ReleasePages(newEnd, oldEnd - newEnd);
+  heapLock->Release();
+  return oldBreak;
+#endif
+}
+
+//----------------------------------------------------------------------
+/**  Free the physical pages and swap sectors of an area, after
+//   waiting for the I/O in progress on its pages, and forbid any
+//   access to it. The area is left as never allocated.
+//
+//    \param firstPage the first page of the area
+//    \param numPages the number of pages of the area
+*/
+//----------------------------------------------------------------------
+void AddrSpace::ReleasePages(int firstPage, int numPages)
+{
+  TranslationTable *tt = translationTable;
+
+  for (int i = firstPage; i < firstPage + numPages; i++) {
+    tt->clearBitReadAllowed(i);
+    tt->clearBitWriteAllowed(i);
+    cowPages->Clear(i);
+    WaitPage(i);
+    if (tt->getBitValid(i)) {
+      int pp = tt->getPhysicalPage(i);
+      if (g_physical_mem_manager->IsZeroPage(pp))
+	tt->clearBitValid(i);
+      else
+	g_physical_mem_manager->UnmapPage(pp, this, i);
+    }
+    if (tt->getBitSwap(i)) {
+      if (tt->getAddrDisk(i) >= 0)
+	g_swap_manager->ReleasePageSwap(tt->getAddrDisk(i));
+      tt->clearBitSwap(i);
+    }
+    tt->setAddrDisk(i, -1);
+  }
+}
+
+//----------------------------------------------------------------------
+/**  Allocate numPages virtual pages in the current address space.
+//   The first free range large enough is used; if there is none, the
+//   pages are taken above freePageId.
 //
 //    \param numPages the number of contiguous virtual pages to allocate
 //    \return the virtual page number of the beginning of the allocated
@@ -381,20 +682,86 @@ int AddrSpace::Alloc(int numPages)
 
   DEBUG('a', (char*)"Virtual space alloc request for %d pages\n", numPages);
 
+  for (int k = 0; k < nb_free_ranges; k++) {
+    if (free_ranges[k].count < numPages)
+      continue;
+    result = free_ranges[k].first;
+    free_ranges[k].first += numPages;
+    free_ranges[k].count -= numPages;
+    if (free_ranges[k].count == 0) {
+      for (; k < nb_free_ranges - 1; k++)
+	free_ranges[k] = free_ranges[k + 1];
+      nb_free_ranges--;
+    }
+    return result;
+  }
+
   // Check if the translation table is big enough for the allocation
   // to succeed
   if (freePageId + numPages >= translationTable->getMaxNumPages())
     return -1;
 
-  // Do the allocation.
-  // The allocation procedure is VERY SIMPLE. It just remembers
-  // the number of the lastly allocated virtual page and increments it
-  // when new pages are allocated. No de-allocation mechanisms is
-  // implemented.
   freePageId += numPages;
   return result;
 }
 
+//----------------------------------------------------------------------
+/**  Give back an area allocated by Alloc, whose pages are released.
+//   It is merged with the free ranges around it, and freePageId goes
+//   down when it is the last area allocated.
+//
+//    \param firstPage the first page of the area
+//    \param numPages the number of pages of the area
+*/
+//----------------------------------------------------------------------
+void AddrSpace::Free(int firstPage, int numPages)
+{
+  DEBUG('a', (char*)"Virtual space free of %d pages at page %d\n",
+	numPages, firstPage);
+
+  // Insertion point in the sorted ranges
+  int pos = 0;
+  while (pos < nb_free_ranges && free_ranges[pos].first < firstPage)
+    pos++;
+
+  // Merge with the previous range, or insert a new range
+  if (pos > 0
+      && free_ranges[pos - 1].first + free_ranges[pos - 1].count == firstPage) {
+    pos--;
+    free_ranges[pos].count += numPages;
+  } else {
+    if (nb_free_ranges == max_free_ranges) {
+      max_free_ranges = (max_free_ranges == 0) ? 8 : 2 * max_free_ranges;
+      s_vrange *t = new s_vrange[max_free_ranges];
+      for (int k = 0; k < nb_free_ranges; k++)
+	t[k] = free_ranges[k];
+      delete[] free_ranges;
+      free_ranges = t;
+    }
+    for (int k = nb_free_ranges; k > pos; k--)
+      free_ranges[k] = free_ranges[k - 1];
+    free_ranges[pos].first = firstPage;
+    free_ranges[pos].count = numPages;
+    nb_free_ranges++;
+  }
+
+  // Merge with the next range
+  if (pos < nb_free_ranges - 1
+      && free_ranges[pos].first + free_ranges[pos].count
+	 == free_ranges[pos + 1].first) {
+    free_ranges[pos].count += free_ranges[pos + 1].count;
+    for (int k = pos + 1; k < nb_free_ranges - 1; k++)
+      free_ranges[k] = free_ranges[k + 1];
+    nb_free_ranges--;
+  }
+
+  // The last range goes back above freePageId
+  if (free_ranges[pos].first + free_ranges[pos].count == freePageId) {
+    freePageId = free_ranges[pos].first;
+    nb_free_ranges--;
+  }
+}
+
 //----------------------------------------------------------------------
 /** Map an open file in memory
  *
@@ -412,19 +779,30 @@ int AddrSpace::Mmap(OpenFile *f, int size)
   int nb_pages = divRoundUp(size, g_cfg->PageSize);
 
   int page_allocated = Alloc(nb_pages);
+  if (page_allocated < 0)
+    return -1;
   int addr_allocated = page_allocated * g_cfg->PageSize;
-  if (addr_allocated == 0) {
-    fprintf(stderr, "Alloc() in Mmap failed to allocate %d bytes\n", size);
-    g_machine->interrupt->Halt(-1);
-  }
 
   s_mapped_file element;
   element.first_address = addr_allocated;
   element.size = nb_pages;
   element.file = f;
 
-  mapped_files[nb_mapped_files] = element;
-
+  // Insert the mapping in address order, growing the table if needed
+  if (nb_mapped_files == max_mapped_files) {
+    max_mapped_files = (max_mapped_files == 0) ? 8 : 2 * max_mapped_files;
+    s_mapped_file *t = new s_mapped_file[max_mapped_files];
+    for (int k = 0; k < nb_mapped_files; k++)
+      t[k] = mapped_files[k];
+    delete[] mapped_files;
+    mapped_files = t;
+  }
+  int pos = nb_mapped_files;
+  while (pos > 0 && mapped_files[pos - 1].first_address > addr_allocated) {
+    mapped_files[pos] = mapped_files[pos - 1];
+    pos--;
+  }
+  mapped_files[pos] = element;
   nb_mapped_files++;
 
   int i, virtualPage, byte_offset;
@@ -458,19 +836,294 @@ OpenFile *AddrSpace::findMappedFile(int32_t addr) {
   printf("**** Warning: method AddrSpace::findMappedFile is not implemented yet\n");
   exit(-1);
 #else
-  int i;
-  for (i = 0; i < nb_mapped_files; i++) {
-      s_mapped_file mf = mapped_files[i];
-      int mf_start = mf.first_address;
-      int mf_end   = mf_start + (mf.size + 1) * g_cfg->PageSize;
-      if (addr >= mf_start && addr < mf_end) {
-        return mf.file;
+  int k = findMapping(addr);
+  return (k == -1) ? NULL : mapped_files[k].file;
+#endif
+}
+
+//----------------------------------------------------------------------
+/*! Search the mapping holding an address, by dichotomy in the table
+ * of mappings sorted by address
+ *
+ * \param addr: virtual address to be searched for
+ * \return index of the mapping in mapped_files, -1 if none
+ */
+//----------------------------------------------------------------------
+int AddrSpace::findMapping(int32_t addr) {
+  int lo = 0, hi = nb_mapped_files - 1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int32_t start = mapped_files[mid].first_address;
+    if (addr < start)
+      hi = mid - 1;
+    else if (addr >= start + mapped_files[mid].size * g_cfg->PageSize)
+      lo = mid + 1;
+    else
+      return mid;
+  }
+  return -1;
+}
+
+//----------------------------------------------------------------------
+/*! Wait until a page is neither under I/O (page fault, eviction) nor
+ * locked in physical memory (page cleaner, Msync...). Nothing changes
+ * it then until the current thread blocks or yields.
+ *
+ * \param virtualPage: the page to wait for
+ */
+//----------------------------------------------------------------------
+void AddrSpace::WaitPage(int virtualPage)
+{
+  TranslationTable *tt = translationTable;
+
+  for (;;) {
+    while (tt->getBitIo(virtualPage))
+      g_page_waits->Wait(this, virtualPage);
+    if (!tt->getBitValid(virtualPage)
+	|| g_physical_mem_manager->IsZeroPage(tt->getPhysicalPage(virtualPage))
+	|| !g_physical_mem_manager->tpr[tt->getPhysicalPage(virtualPage)].locked)
+      return;
+    g_physical_mem_manager->WaitUnlocked(tt->getPhysicalPage(virtualPage));
+  }
+}
+
+//----------------------------------------------------------------------
+/*! Write back the modified pages of a file mapping. Runs of
+ * consecutive modified pages, which are consecutive in the file, are
+ * written by a single WriteAt, up to SYNC_BATCH pages. The pages are
+ * locked during the write so that they are not evicted, and their M
+ * bit is cleared before they are copied, so that a modification
+ * made during the write is not lost.
+ *
+ * \param mf: the mapping
+ * \return the number of pages written
+ */
+//----------------------------------------------------------------------
+int AddrSpace::SyncMapping(s_mapped_file *mf)
+{
+  TranslationTable *tt = translationTable;
+  PhysicalMemManager *mem = g_physical_mem_manager;
+  int firstPage = mf->first_address / g_cfg->PageSize;
+  OpenFile *f = mf->file;
+  char *buffer = new char[SYNC_BATCH * g_cfg->PageSize];
+  int written = 0;
+  int i = 0;
+
+  while (i < mf->size) {
+    int n = 0;
+    while (n < SYNC_BATCH && i + n < mf->size) {
+      int v = firstPage + i + n;
+      if (n == 0)
+	WaitPage(v);
+      else if (tt->getBitIo(v)
+	       || (tt->getBitValid(v) && mem->tpr[tt->getPhysicalPage(v)].locked))
+	break;
+      if (!tt->getBitValid(v) || !tt->getBitM(v))
+	break;
+      int pp = tt->getPhysicalPage(v);
+      mem->tpr[pp].locked = true;
+      tt->clearBitM(v);
+      memcpy(buffer + n * g_cfg->PageSize,
+	     &(g_machine->mainMemory[pp * g_cfg->PageSize]), g_cfg->PageSize);
+      n++;
+    }
+    if (n == 0) {
+      i++;
+      continue;
+    }
+    f->WriteAt(buffer, n * g_cfg->PageSize, tt->getAddrDisk(firstPage + i));
+    for (int k = 0; k < n; k++)
+      mem->UnlockPage(tt->getPhysicalPage(firstPage + i + k));
+    written += n;
+    i += n;
+  }
+  delete[] buffer;
+  DEBUG('a', (char *)"Msync at 0x%x: %d pages written\n",
+	mf->first_address, written);
+  return written;
+}
+
+//----------------------------------------------------------------------
+/*! Write back the modified pages of a file mapping
+ *
+ * \param addr: an address in the mapping
+ * \return the number of pages written, -1 if no file is mapped at addr
+ */
+//----------------------------------------------------------------------
+int AddrSpace::Msync(int32_t addr)
+{
+  int k = findMapping(addr);
+  if (k == -1)
+    return -1;
+  s_mapped_file mf = mapped_files[k];
+  return SyncMapping(&mf);
+}
+
+//----------------------------------------------------------------------
+/*! Remove a file mapping. Its modified pages are written back to the
+ * file, its physical pages freed, and its virtual pages made
+ * inaccessible (they are not reused).
+ *
+ * \param addr: address returned by Mmap
+ * \return 0, or -1 if no file is mapped at addr
+ */
+//----------------------------------------------------------------------
+int AddrSpace::Munmap(int32_t addr)
+{
+  TranslationTable *tt = translationTable;
+  int k = findMapping(addr);
+
+  if (k == -1 || mapped_files[k].first_address != addr)
+    return -1;
+  s_mapped_file mf = mapped_files[k];
+  SyncMapping(&mf);
+
+  int firstPage = mf.first_address / g_cfg->PageSize;
+  for (int i = 0; i < mf.size; i++) {
+    int v = firstPage + i;
+    for (;;) {
+      WaitPage(v);
+      if (!tt->getBitValid(v))
+	break;
+      if (!tt->getBitM(v)) {
+	g_physical_mem_manager->UnmapPage(tt->getPhysicalPage(v), this, v);
+	break;
       }
+      // Modified again since SyncMapping
+      s_mapped_file page = mf;
+      page.first_address = v * g_cfg->PageSize;
+      page.size = 1;
+      SyncMapping(&page);
+    }
+    tt->clearBitReadAllowed(v);
+    tt->clearBitWriteAllowed(v);
+    tt->setAddrDisk(v, -1);
+  }
+
+  // The table may have changed meanwhile (another thread may even
+  // have removed this mapping already)
+  k = findMapping(addr);
+  if (k != -1) {
+    for (; k < nb_mapped_files - 1; k++)
+      mapped_files[k] = mapped_files[k + 1];
+    nb_mapped_files--;
+    Free(firstPage, mf.size);
   }
-  return NULL;
+  return 0;
+}
+
+//----------------------------------------------------------------------
+/*! Give write access to a copy-on-write page (called on a write to
+ * a read-only page). While the physical page is still shared with
+ * another address space, the page is first copied to a new physical
+ * page; once it is not shared any more, it is simply made writable.
+ *
+ * \param virtualPage: the page written to
+ * \return false if the page is really read-only
+ */
+//----------------------------------------------------------------------
+bool AddrSpace::CopyOnWrite(int virtualPage)
+{
+#ifndef ETUDIANTS_TP
+  return false;
+#else
+  TranslationTable *tt = translationTable;
+  PhysicalMemManager *mem = g_physical_mem_manager;
+  int pp = -1;
+
+  if (virtualPage < 0 || virtualPage >= tt->getMaxNumPages())
+    return false;
+
+  // Wait for the page faults, evictions and write-backs in progress
+  WaitPage(virtualPage);
+  if (tt->getBitValid(virtualPage))
+    pp = tt->getPhysicalPage(virtualPage);
+
+  // Another thread of the process may have done the job meanwhile
+  if (!cowPages->Test(virtualPage))
+    return tt->getBitWriteAllowed(virtualPage);
+
+  if (pp != -1 && (mem->IsZeroPage(pp) || mem->GetRefCount(pp) > 1)) {
+    DEBUG('a', (char *)"Copy-on-write of virtual page %d\n", virtualPage);
+    bool zero = mem->IsZeroPage(pp);
+    tt->setBitIo(virtualPage);
+    mem->tpr[pp].locked = true;
+    int np = mem->AddPhysicalToVirtualMapping(this, virtualPage);
+    memcpy(&(g_machine->mainMemory[np * g_cfg->PageSize]),
+	   &(g_machine->mainMemory[pp * g_cfg->PageSize]), g_cfg->PageSize);
+    bool dirty = tt->getBitM(virtualPage);
+    if (!zero) {
+      mem->UnlockPage(pp);
+      mem->UnmapPage(pp, this, virtualPage);
+    }
+
+    tt->setPhysicalPage(virtualPage, np);
+    if (dirty)
+      tt->setBitM(virtualPage);
+    else
+      tt->clearBitM(virtualPage);
+    tt->setBitU(virtualPage);
+    tt->setBitValid(virtualPage);
+    mem->UnlockPage(np);
+    tt->clearBitIo(virtualPage);
+    g_page_waits->Wake(this, virtualPage);
+  }
+
+  cowPages->Clear(virtualPage);
+  tt->setBitWriteAllowed(virtualPage);
+  return true;
 #endif
 }
 
+//----------------------------------------------------------------------
+/*! Map the zero page of the PhysicalMemManager at an anonymous page
+ * read before being written. A writable page becomes copy-on-write,
+ * and gets its own physical page on the first write.
+ *
+ * \param virtualPage: the page to map (under I/O, not valid)
+ */
+//----------------------------------------------------------------------
+void AddrSpace::MapZeroPage(int virtualPage)
+{
+  TranslationTable *tt = translationTable;
+
+  if (tt->getBitWriteAllowed(virtualPage)) {
+    tt->clearBitWriteAllowed(virtualPage);
+    cowPages->Mark(virtualPage);
+  }
+  tt->setPhysicalPage(virtualPage, g_physical_mem_manager->ZeroPage());
+  tt->clearBitM(virtualPage);
+  tt->setBitU(virtualPage);
+  tt->setBitValid(virtualPage);
+  tt->clearBitIo(virtualPage);
+  g_page_waits->Wake(this, virtualPage);
+}
+
+//----------------------------------------------------------------------
+/*! Check whether a page is a read-only page of the executable file
+ * (text, rodata), never written to the swap area: such a page has the
+ * same contents in all the processes running the same program, and
+ * can be shared through the text page cache of the PhysicalMemManager.
+ * Copy-on-write pages are excluded, as they will be made writable.
+ *
+ * \param virtualPage: the page to check
+ * \return true if the page can go in the text page cache
+ */
+//----------------------------------------------------------------------
+bool AddrSpace::IsSharedText(int virtualPage)
+{
+  TranslationTable *tt = translationTable;
+
+  return process->exec_file != NULL
+    && tt->getBitReadAllowed(virtualPage)
+    && !tt->getBitWriteAllowed(virtualPage)
+    && !cowPages->Test(virtualPage)
+    && !tt->getBitSwap(virtualPage)
+    && tt->getAddrDisk(virtualPage) != -1
+    && findMappedFile(virtualPage * g_cfg->PageSize) == NULL;
+}
+
 //----------------------------------------------------------------------
 // SwapELFHeader
 /*! 	Do little endian to big endian conversion on the bytes in the 
@@ -14,6 +14,7 @@
 
 #include "kernel/copyright.h"
 #include "utility/list.h"
+#include "utility/intrusivelist.h"
 #include "filesys/openfile.h"
 
 // Forward references
@@ -21,15 +22,24 @@ class Thread;
 class Semaphore;
 class OpenFile;
 class Process;
+class BitMap;
+class Lock;
+
+//! Number of pages written back at once by Msync
+#define SYNC_BATCH 8
+
+//! A range of free virtual pages, below the last page allocated
+typedef struct {
+        int first;              //!< First page of the range
+        int count;              //!< Number of pages
+} s_vrange;
 
-#define MAX_MAPPED_FILES 10
 //! Information describing a memory-mapped file
 typedef struct {
-        int32_t first_address;
-        int size;
-        OpenFile *file;
+        int32_t first_address;  //!< Virtual address of the first page
+        int size;               //!< Number of pages mapped
+        OpenFile *file;         //!< File mapped from its beginning
 } s_mapped_file;
-typedef s_mapped_file t_mapped_files[MAX_MAPPED_FILES];
 
 /**
  @brief Defines the data structures to keep track of memory resources of
@@ -67,6 +77,17 @@ public:
    //   \param err: error code 0 if OK, -1 otherwise 
    */
   AddrSpace(OpenFile *exec_file, Process *p, int * err);
+
+  /**   Create a copy of an address space, for a process created by
+   //   Fork. No page is copied: the physical pages and swap sectors
+   //   of the parent are shared, and writable pages become
+   //   copy-on-write in both address spaces (see CopyOnWrite).
+   //
+   //   \param parent: the address space to copy
+   //   \param process: process of the new address space
+   //   \param err: error code NoError if OK
+   */
+  AddrSpace(AddrSpace *parent, Process *p, int *err);
  
   /**   Deallocates an address space and in particular frees
    *   all memory it uses (RAM and swap area).
@@ -82,6 +103,34 @@ public:
    */
   int StackAllocate();                  
 
+  /**	Release the stack of a finishing thread, with its guard pages:
+   *    its physical pages and swap sectors are freed, and its virtual
+   *    pages may be allocated again.
+   *
+   *      \param stackPointer the stack pointer returned by StackAllocate
+   */
+  void StackRelease(int stackPointer);
+
+  /**	Allocates size bytes of zero-filled virtual memory (rounded up
+   *    to a whole number of pages), for use by the kernel on behalf
+   *    of the process.
+   *
+   *      \return the virtual address of the area, -1 if there is
+   *      not enough virtual space
+   */
+  int AnonAllocate(int size);
+
+  /**	Move the end of the heap of the process (the break) by increment
+   *    bytes. The heap is a region of demand-zero pages, reserved at
+   *    the first call; pages are only given a physical page when
+   *    accessed, and the pages left above the break when it goes down
+   *    are freed.
+   *
+   *      \return the previous break, -1 if the heap cannot grow or
+   *      shrink that much
+   */
+  int Sbrk(int increment);
+
   /** Returns the address of the first instruction to execute in the process
     found in the ELF file */
   int32_t getCodeStartAddress()
@@ -99,6 +148,20 @@ public:
    */
   int Mmap(OpenFile *f, int size);
 
+  /*! Remove a file mapping, writing its modified pages back first
+   *
+   * \param addr: address returned by Mmap
+   * \return 0, or -1 if no file is mapped at addr
+   */
+  int Munmap(int32_t addr);
+
+  /*! Write back the modified pages of a file mapping
+   *
+   * \param addr: an address in the mapping
+   * \return the number of pages written, -1 if no file is mapped at addr
+   */
+  int Msync(int32_t addr);
+
   /*! Search if the address is in a memory-mapped file
    *
    * \param addr: virtual address to be searched for
@@ -106,6 +169,60 @@ public:
    */
   OpenFile *findMappedFile(int32_t addr);
 
+  //! Number of files mapped in memory
+  int NumMappedFiles() { return nb_mapped_files; }
+
+  /*! Give write access to a copy-on-write page, copying it if it is
+   *  still shared with another address space
+   *
+   * \param virtualPage: the page written to
+   * \return false if the page is really read-only
+   */
+  bool CopyOnWrite(int virtualPage);
+
+  /*! Map the shared zero page at an anonymous page, copy-on-write
+   *
+   * \param virtualPage: the page read before being written
+   */
+  void MapZeroPage(int virtualPage);
+
+  /*! Check whether a page is a read-only page of the executable file,
+   *  which can be shared with the other processes running it
+   *
+   * \param virtualPage: the page to check
+   * \return true if the page can go in the text page cache
+   */
+  bool IsSharedText(int virtualPage);
+
+  /*! Page expected to fault next if faults follow a sequential
+      stream (see PageFaultManager::PageFault) */
+  int faultNext;
+
+  /*! Number of pages brought in by the next sequential fault */
+  int faultWindow;
+
+  /*! Number of physical pages owned (see PhysicalMemManager) */
+  int residentPages;
+
+  /*! Local replacement: number of physical pages beyond which the
+      process replaces its own pages, adjusted by the page fault
+      frequency */
+  int residentTarget;
+
+  /*! Time of the last page fault, for the page fault frequency */
+  Time lastFault;
+
+  /*! true while the process is suspended by admission control */
+  bool suspended;
+
+  /*! true if the address space runs a program, and so takes part in
+      admission control (the empty address space of the kernel threads
+      does not) */
+  bool counted;
+
+  /*! Links in the list of suspended address spaces */
+  ListHook<AddrSpace> suspendHook;
+
 private:
   //* Code start address, found in the ELF file
   int32_t CodeStartAddress; 
@@ -118,19 +235,57 @@ private:
    */ 
   int Alloc(int numPages);
 
-  /** Number of the next virtual page to be allocated.
-    Virtual addresses allocated in a very simple manner : an
-    allocation will simply increment this address by
-    the size of the allocated object (there are no complex
-    malloc/free functions implemented yet) */
+  /**  Give back virtual pages allocated by Alloc, once released
+   //
+   //    \param firstPage the first page of the area
+   //    \param numPages the number of pages of the area
+   */
+  void Free(int firstPage, int numPages);
+
+  /**  Free the physical pages and swap sectors of an area, and forbid
+   //   any access to it
+   //
+   //    \param firstPage the first page of the area
+   //    \param numPages the number of pages of the area
+   */
+  void ReleasePages(int firstPage, int numPages);
+
+  /** Number of the page following the last page allocated. Pages are
+    taken from free_ranges first (first fit), and above freePageId
+    when no free range is large enough. */
   int freePageId; 
+
+  /*! Ranges of free pages under freePageId, sorted and never
+      adjacent (grown on demand) */
+  s_vrange *free_ranges;
+  int nb_free_ranges;    //!< Number of entries used in free_ranges
+  int max_free_ranges;   //!< Number of entries allocated in free_ranges
   
   /*! (Heavyweight) process using this address space */
   Process *process;
 
-  /*! List of memory-mapped files */
-  int nb_mapped_files;
-  t_mapped_files mapped_files;
+  /*! Pages shared copy-on-write since a Fork: they are mapped
+      read-only until written to */
+  BitMap *cowPages;
+
+  /*! Memory-mapped files, sorted by address (grown on demand) */
+  s_mapped_file *mapped_files;
+  int nb_mapped_files;   //!< Number of entries used in mapped_files
+  int max_mapped_files;  //!< Number of entries allocated in mapped_files
+
+  int heapBase;    //!< First virtual page of the heap, -1 before the first Sbrk
+  int heapPages;   //!< Number of virtual pages reserved for the heap
+  int heapBreak;   //!< Address of the end of the heap
+  Lock *heapLock;  //!< Serializes the calls to Sbrk, which may block
+
+  /*! Index in mapped_files of the mapping holding addr, -1 if none */
+  int findMapping(int32_t addr);
+
+  /*! Write back the modified pages of a mapping */
+  int SyncMapping(s_mapped_file *mf);
+
+  /*! Wait until a page is neither under I/O nor locked in memory */
+  void WaitPage(int virtualPage);
 };
 
 #endif // ADDRSPACE_H
@@ -21,9 +21,13 @@
 
 #include "drivers/drvACIA.h"
 #include "drivers/drvConsole.h"
+#include "drivers/drvDisk.h"
 #include "filesys/oftable.h"
+#include "kernel/futex.h"
 #include "kernel/msgerror.h"
+#include "kernel/scheduler.h"
 #include "kernel/synch.h"
+#include "kernel/syscallring.h"
 #include "kernel/system.h"
 #include "machine/machine.h"
 #include "userlib/syscall.h"
@@ -117,6 +121,8 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 		case SC_HALT:
 			// The halt system call. Stops Nachos.
 			DEBUG('e', (char *)"Shutdown, initiated by user program.\n");
+			// Dirty sectors of the disk cache would be lost
+			g_disk_driver->Sync();
 			g_machine->interrupt->Halt(0);
 			g_syscall_error->SetMsg((char *)"", NoError);
 			return;
@@ -254,6 +260,64 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 			break;
 		}
 
+		case SC_SLEEP: {
+			DEBUG('e', (char *)"Process or thread: Sleep call.\n");
+			int ticks = g_machine->ReadIntRegister(4);
+			if (ticks <= 0)
+				g_current_thread->Yield();
+			else {
+				IntStatus oldLevel =
+					g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+				g_current_thread->TimedSleep(NULL, ticks);
+				g_machine->interrupt->SetStatus(oldLevel);
+			}
+			g_syscall_error->SetMsg((char *)"", NoError);
+			break;
+		}
+
+		case SC_SET_PRIORITY: {
+			DEBUG('e', (char *)"Process or thread: SetPriority call.\n");
+			int prio = g_machine->ReadIntRegister(4);
+			if (prio >= 0 && prio < NUM_PRIORITIES) {
+				int old = g_current_thread->GetBasePriority();
+				g_current_thread->SetPriority(prio);
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, old);
+				// A thread of higher priority may be ready now
+				if (prio < old)
+					g_current_thread->Yield();
+			} else {
+				sprintf(msg, "%d", prio);
+				g_syscall_error->SetMsg(msg, InvalidPriority);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_FORK: {
+			// The fork system call
+			// Creates a copy of the process, sharing its memory
+			// copy-on-write, with a copy of the calling thread
+			DEBUG('e', (char *)"Process: Fork call.\n");
+			int error;
+			Process *parent = g_current_thread->GetProcessOwner();
+			Process *p = new Process(parent, &error);
+			if (error != NoError) {
+				delete p;
+				g_machine->WriteIntRegister(2, -1);
+				g_syscall_error->SetMsg(parent->getName(), error);
+				break;
+			}
+			sprintf(msg, "master thread of forked process %s",
+					parent->getName());
+			Thread *ptThread = new Thread(msg);
+			int32_t tid = g_object_ids->AddObject(ptThread);
+			ptThread->StartFork(p);
+			g_syscall_error->SetMsg((char *)"", NoError);
+			g_machine->WriteIntRegister(2, tid);
+			break;
+		}
+
 		case SC_PERROR: {
 			// the PError system call
 			// print the last error message
@@ -626,6 +690,25 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 			break;
 		}
 
+		case SC_P_TIMED: {
+			DEBUG('s', (char *)"Semaphore: timed P call.\n");
+			int32_t sid;
+			Semaphore *ptSem;
+			sid = g_machine->ReadIntRegister(4);
+			int ticks = g_machine->ReadIntRegister(5);
+			ptSem = (Semaphore *)g_object_ids->SearchObject(sid);
+			if (ptSem && ptSem->typeId == SEMAPHORE_TYPE_ID) {
+				bool taken = ptSem->PTimed(ticks);
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, taken ? 0 : 1);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidSemaphoreId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
 		case SC_V: {
 			DEBUG('s', (char *)"Semaphore: verhogen call.\n");
 			int32_t sid;
@@ -879,6 +962,183 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 			break;
 		}
 
+		case SC_RWLOCK_CREATE: {
+			// Create a new reader-writer lock
+			DEBUG('s', (char *)"RWLock: Create call.\n");
+			int addr;
+			int sizep;
+			addr = g_machine->ReadIntRegister(4);
+			sizep = GetLengthParam(addr);
+			char debugName[sizep];
+			GetStringParam(addr, debugName, sizep);
+			RWLock *rwlock = new RWLock(debugName);
+			g_syscall_error->SetMsg((char *)"", NoError);
+			g_machine->WriteIntRegister(2, g_object_ids->AddObject(rwlock));
+			break;
+		}
+
+		case SC_RWLOCK_DESTROY: {
+			DEBUG('s', (char *)"RWLock: Destroy call.\n");
+			int32_t sid;
+			RWLock *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (RWLock *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == RWLOCK_TYPE_ID) {
+				delete pt;
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidRWLockId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_RWLOCK_READ: {
+			DEBUG('s', (char *)"RWLock: read acquire call.\n");
+			int32_t sid;
+			RWLock *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (RWLock *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == RWLOCK_TYPE_ID) {
+				pt->AcquireRead();
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidRWLockId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_RWLOCK_WRITE: {
+			DEBUG('s', (char *)"RWLock: write acquire call.\n");
+			int32_t sid;
+			RWLock *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (RWLock *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == RWLOCK_TYPE_ID) {
+				pt->AcquireWrite();
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidRWLockId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_RWLOCK_RELEASE: {
+			DEBUG('s', (char *)"RWLock: release call.\n");
+			int32_t sid;
+			RWLock *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (RWLock *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == RWLOCK_TYPE_ID) {
+				pt->Release();
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidRWLockId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_BARRIER_CREATE: {
+			// Create a new barrier for a given number of threads
+			DEBUG('s', (char *)"Barrier: Create call.\n");
+			int addr;
+			int count;
+			int sizep;
+			addr = g_machine->ReadIntRegister(4);
+			count = g_machine->ReadIntRegister(5);
+			if (count <= 0) {
+				sprintf(msg, "%d", count);
+				g_syscall_error->SetMsg(msg, InvalidBarrierCount);
+				g_machine->WriteIntRegister(2, -1);
+				break;
+			}
+			sizep = GetLengthParam(addr);
+			char debugName[sizep];
+			GetStringParam(addr, debugName, sizep);
+			Barrier *barrier = new Barrier(debugName, count);
+			g_syscall_error->SetMsg((char *)"", NoError);
+			g_machine->WriteIntRegister(2, g_object_ids->AddObject(barrier));
+			break;
+		}
+
+		case SC_BARRIER_DESTROY: {
+			DEBUG('s', (char *)"Barrier: Destroy call.\n");
+			int32_t sid;
+			Barrier *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (Barrier *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == BARRIER_TYPE_ID) {
+				delete pt;
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidBarrierId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_BARRIER_WAIT: {
+			DEBUG('s', (char *)"Barrier: Wait call.\n");
+			int32_t sid;
+			Barrier *pt;
+			sid = g_machine->ReadIntRegister(4);
+			pt = (Barrier *)g_object_ids->SearchObject(sid);
+			if (pt && pt->typeId == BARRIER_TYPE_ID) {
+				pt->Wait();
+				g_syscall_error->SetMsg((char *)"", NoError);
+				g_machine->WriteIntRegister(2, 0);
+			} else {
+				sprintf(msg, "%d", sid);
+				g_syscall_error->SetMsg(msg, InvalidBarrierId);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
+		case SC_RING_SETUP: {
+			DEBUG('e', (char *)"Ring: Setup call.\n");
+			Process *p = g_current_thread->GetProcessOwner();
+			if (p->ring == NULL) {
+				int addr = p->addrspace->AnonAllocate(sizeof(RingPage));
+				if (addr < 0) {
+					g_syscall_error->SetMsg((char *)"", OutOfMemory);
+					g_machine->WriteIntRegister(2, 0);
+					break;
+				}
+				p->ring = new SyscallRing(addr);
+			}
+			g_syscall_error->SetMsg((char *)"", NoError);
+			g_machine->WriteIntRegister(2, p->ring->GetAddr());
+			break;
+		}
+
+		case SC_RING_ENTER: {
+			DEBUG('e', (char *)"Ring: Enter call.\n");
+			int count = g_machine->ReadIntRegister(4);
+			Process *p = g_current_thread->GetProcessOwner();
+			if (p->ring != NULL) {
+				g_machine->WriteIntRegister(2, p->ring->Enter(count));
+				g_syscall_error->SetMsg((char *)"", NoError);
+			} else {
+				g_syscall_error->SetMsg((char *)"", NoSyscallRing);
+				g_machine->WriteIntRegister(2, -1);
+			}
+			break;
+		}
+
 		case SC_MMAP: {
 			DEBUG('e', (char*)"Filesystem: call SC_MMAP\n");
 			// Get the openfile number
@@ -905,6 +1165,70 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 			}
 			break;
 		}
+
+		case SC_MUNMAP: {
+			DEBUG('e', (char*)"Filesystem: call SC_MUNMAP\n");
+			int32_t addr = g_machine->ReadIntRegister(4);
+			AddrSpace *as = g_current_thread->GetProcessOwner()->addrspace;
+			int result = as->Munmap(addr);
+			if (result < 0) {
+				sprintf(msg, "0x%x", addr);
+				g_syscall_error->SetMsg(msg, InvalidMapping);
+			} else
+				g_syscall_error->SetMsg((char*)"", NoError);
+			g_machine->WriteIntRegister(2, result);
+			break;
+		}
+
+		case SC_MSYNC: {
+			DEBUG('e', (char*)"Filesystem: call SC_MSYNC\n");
+			int32_t addr = g_machine->ReadIntRegister(4);
+			AddrSpace *as = g_current_thread->GetProcessOwner()->addrspace;
+			int result = as->Msync(addr);
+			if (result < 0) {
+				sprintf(msg, "0x%x", addr);
+				g_syscall_error->SetMsg(msg, InvalidMapping);
+			} else
+				g_syscall_error->SetMsg((char*)"", NoError);
+			g_machine->WriteIntRegister(2, result);
+			break;
+		}
+
+		case SC_SBRK: {
+			DEBUG('e', (char*)"Process: call SC_SBRK\n");
+			int increment = g_machine->ReadIntRegister(4);
+			AddrSpace *as = g_current_thread->GetProcessOwner()->addrspace;
+			int result = as->Sbrk(increment);
+			if (result < 0)
+				g_syscall_error->SetMsg((char*)"Sbrk() failed\n", OutOfMemory);
+			else
+				g_syscall_error->SetMsg((char*)"", NoError);
+			g_machine->WriteIntRegister(2, result);
+			break;
+		}
+
+		case SC_FUTEX_WAIT: {
+			DEBUG('s', (char *)"Futex: wait call.\n");
+			int32_t addr = g_machine->ReadIntRegister(4);
+			int32_t val = g_machine->ReadIntRegister(5);
+			int result = g_futex_table->Wait(addr, val);
+			if (result < 0) {
+				sprintf(msg, "0x%x", addr);
+				g_syscall_error->SetMsg(msg, InvalidFutexAddr);
+			} else
+				g_syscall_error->SetMsg((char *)"", NoError);
+			g_machine->WriteIntRegister(2, result);
+			break;
+		}
+
+		case SC_FUTEX_WAKE: {
+			DEBUG('s', (char *)"Futex: wake call.\n");
+			int32_t addr = g_machine->ReadIntRegister(4);
+			int count = g_machine->ReadIntRegister(5);
+			g_machine->WriteIntRegister(2, g_futex_table->Wake(addr, count));
+			g_syscall_error->SetMsg((char *)"", NoError);
+			break;
+		}
 #endif
 
 		default:
@@ -925,6 +1249,11 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 	// Other exceptions
 	// ----------------
 	case READONLY_EXCEPTION:
+		// Write to a page shared copy-on-write since a Fork: the
+		// access is granted once the page is private
+		if (g_current_thread->GetProcessOwner()->addrspace->CopyOnWrite(
+				vaddr / g_cfg->PageSize))
+			break;
 		printf("FATAL USER EXCEPTION (Thread %s, PC=0x%x):\n",
 			   g_current_thread->GetName(), g_machine->ReadIntRegister(PC_REG));
 		printf("\t*** Write to virtual address 0x%x on read-only page ***\n",
@@ -961,9 +1290,16 @@ void ExceptionHandler(ExceptionType exceptiontype, int vaddr) {
 		g_machine->interrupt->Halt(-1);
 		break;
 
+	case COPUNUSABLE_EXCEPTION:
+		// First floating point instruction since the thread got the
+		// CPU: load its FP registers, the instruction is then restarted
+		g_current_thread->RestoreFPState();
+		break;
+
 	case PAGEFAULT_EXCEPTION:
 		ExceptionType e;
-		e = g_page_fault_manager->PageFault(vaddr / g_cfg->PageSize);
+		e = g_page_fault_manager->PageFault(vaddr / g_cfg->PageSize,
+											g_machine->mmu->faultOnWrite);
 		if (e != NO_EXCEPTION) {
 			printf("\t*** Page fault handling failed, ... exiting\n");
 			g_machine->interrupt->Halt(-1);
@@ -0,0 +1,124 @@
+/*! \file futex.cc
+//  \brief Routines implementing the kernel side of futexes.
+//
+//  Atomicity between the test of the futex value and the blocking of
+//  the thread is provided by disabling interrupts, as for the other
+//  synchronization objects (see synch.cc).
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.
+//  See copyright_insa.h for copyright notice and limitation
+//  of liability and disclaimer of warranty provisions.
+*/
+
+#include "kernel/system.h"
+#include "kernel/scheduler.h"
+#include "kernel/futex.h"
+
+//----------------------------------------------------------------------
+// FutexTable::FutexTable
+/*! 	Initialize the table with empty wait queues.
+*/
+//----------------------------------------------------------------------
+FutexTable::FutexTable() {
+	for (int i = 0; i < FUTEX_HASH_SIZE; i++)
+		buckets[i] = new IntrusiveList<Thread>(&Thread::queueHook);
+}
+
+//----------------------------------------------------------------------
+// FutexTable::~FutexTable
+/*! 	De-allocate the wait queues.
+*/
+//----------------------------------------------------------------------
+FutexTable::~FutexTable() {
+	for (int i = 0; i < FUTEX_HASH_SIZE; i++)
+		delete buckets[i];
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Bucket
+/*! 	Return the wait queue of the futex at virtual address addr in
+//	address space space. Futexes of different processes are distinct
+//	even at the same virtual address.
+*/
+//----------------------------------------------------------------------
+IntrusiveList<Thread> *FutexTable::Bucket(AddrSpace *space, int32_t addr) {
+	uint32_t h = ((uint32_t)(intptr_t)space >> 4) ^ ((uint32_t)addr >> 2);
+	return buckets[h % FUTEX_HASH_SIZE];
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wait
+/*! 	Block the current thread until a FutexWake on addr, provided the
+//	word at addr still contains val. Reading the word and blocking is
+//	atomic with respect to Wake, so a wake-up cannot be lost between
+//	the test made at user level and the sleep.
+//
+//	\param addr virtual address of the futex (word aligned)
+//	\param val value the caller expects at addr
+//	\return 0 when woken up, 1 if the word no longer contained val,
+//		-1 if addr is invalid
+*/
+//----------------------------------------------------------------------
+int FutexTable::Wait(int32_t addr, int32_t val) {
+	int cur;
+
+	if (addr & 0x3)
+		return -1;
+
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+	// May page fault, the value is read once the page is present
+	if (!g_machine->mmu->ReadMem(addr, 4, &cur, false)) {
+		g_machine->interrupt->SetStatus(oldLevel);
+		return -1;
+	}
+	if (cur != val) {
+		g_machine->interrupt->SetStatus(oldLevel);
+		return 1;
+	}
+
+	DEBUG('s', (char *)"FutexWait(0x%x) by %s\n", addr,
+		  g_current_thread->GetName());
+	g_current_thread->futexAddr = addr;
+	Bucket(g_current_thread->GetProcessOwner()->addrspace, addr)
+		->Append(g_current_thread);
+	g_current_thread->Sleep();
+
+	g_machine->interrupt->SetStatus(oldLevel);
+	return 0;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wake
+/*! 	Wake up at most count threads of the current process blocked
+//	on the futex at addr, in FIFO order.
+//
+//	\param addr virtual address of the futex
+//	\param count maximum number of threads to wake up
+//	\return the number of threads actually woken up
+*/
+//----------------------------------------------------------------------
+int FutexTable::Wake(int32_t addr, int count) {
+	int woken = 0;
+	AddrSpace *space = g_current_thread->GetProcessOwner()->addrspace;
+
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+	IntrusiveList<Thread> *queue = Bucket(space, addr);
+	Thread *t = queue->getFirst();
+	while (t != NULL && woken < count) {
+		Thread *next = queue->getNext(t);
+		if (t->futexAddr == addr &&
+			t->GetProcessOwner()->addrspace == space) {
+			queue->RemoveItem(t);
+			g_scheduler->ReadyToRun(t);
+			woken++;
+		}
+		t = next;
+	}
+
+	g_machine->interrupt->SetStatus(oldLevel);
+	DEBUG('s', (char *)"FutexWake(0x%x) woke %d thread(s)\n", addr, woken);
+	return woken;
+}
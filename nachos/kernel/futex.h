@@ -0,0 +1,52 @@
+/*! \file futex.h
+    \brief Data structures for fast user-level synchronization
+
+    A futex is an integer word in the memory of a user process. The
+    user library manipulates it with atomic instructions (LL/SC), and
+    only calls the kernel when a thread has to block on it
+    (FutexWait) or when blocked threads have to be woken up
+    (FutexWake). The uncontended path of the user-level mutex and
+    condition variables of libnachos therefore never traps.
+
+    The kernel does not allocate anything per futex: blocked threads
+    are linked, through their queue hook, into a fixed hash table of
+    wait queues indexed by (address space, virtual address).
+
+    Copyright (c) 1999-2000 INSA de Rennes.
+    All rights reserved.
+    See copyright_insa.h for copyright notice and limitation
+    of liability and disclaimer of warranty provisions.
+*/
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "kernel/copyright.h"
+#include "kernel/system.h"
+#include "kernel/thread.h"
+#include "utility/intrusivelist.h"
+
+//! Number of wait queues of the futex hash table
+#define FUTEX_HASH_SIZE 64
+
+/*! \brief Defines the table of wait queues of the futexes
+*/
+class FutexTable {
+public:
+  FutexTable();   //!< Build an empty table
+  ~FutexTable();  //!< De-allocate the table (nobody may be waiting)
+
+  //! Block the current thread on the futex at addr if it still holds val
+  int Wait(int32_t addr, int32_t val);
+
+  //! Wake up at most count threads blocked on the futex at addr
+  int Wake(int32_t addr, int count);
+
+private:
+  //! Wait queue where threads blocked at addr in space are linked
+  IntrusiveList<Thread> *Bucket(AddrSpace *space, int32_t addr);
+
+  IntrusiveList<Thread> *buckets[FUTEX_HASH_SIZE]; //!< Wait queues
+};
+
+#endif // FUTEX_H
@@ -42,8 +42,17 @@ SyscallError::SyscallError() {
   msgs[InvalidConditionId] = (char*)"invalid condition identifier %s\n";
   msgs[InvalidFileId] = (char*)"invalid file identifier %s\n";
   msgs[InvalidThreadId] = (char*)"invalid thread identifier %s\n";
+  msgs[InvalidRWLockId] = (char*)"invalid reader-writer lock identifier %s\n";
+  msgs[InvalidBarrierId] = (char*)"invalid barrier identifier %s\n";
+  msgs[InvalidBarrierCount] = (char*)"invalid barrier thread count %s\n";
 
   msgs[NoACIA] = (char*)"no ACIA driver installed %s\n";
+
+  msgs[InvalidFutexAddr] = (char*)"invalid futex address %s\n";
+  msgs[NoSyscallRing] = (char*)"no system call ring set up %s\n";
+  msgs[InvalidPriority] = (char*)"invalid thread priority %s\n";
+  msgs[ForkMappedFiles] = (char*)"cannot fork a process with mapped files %s\n";
+  msgs[InvalidMapping] = (char*)"no file mapped at address %s\n";
 }
 
 
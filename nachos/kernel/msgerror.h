@@ -41,9 +41,18 @@ enum
   InvalidConditionId,
   InvalidFileId,
   InvalidThreadId,
+  InvalidRWLockId,
+  InvalidBarrierId,
+  InvalidBarrierCount,
 
   NoACIA,
 
+  InvalidFutexAddr,
+  NoSyscallRing,
+  InvalidPriority,
+  ForkMappedFiles,
+  InvalidMapping,
+
   NUMMSGERROR /* Must always be last */
 };
 
@@ -5,6 +5,7 @@
 #include "kernel/system.h"
 #include "kernel/msgerror.h"
 #include "kernel/process.h"
+#include "kernel/syscallring.h"
 
 //----------------------------------------------------------------------
 // Process::Process
@@ -19,6 +20,7 @@
 Process::Process(char *filename, int *err)
 {
   numThreads=0;
+  ring = NULL;
   *err = NoError;
   if (filename == NULL)
     {
@@ -68,6 +70,58 @@ Process::Process(char *filename, int *err)
 
 }
 
+//----------------------------------------------------------------------
+// Process::Process
+/*! 	Constructor for Fork. Create a process running the same program
+//      as parent, with a copy-on-write copy of its address space,
+//      without any thread in it. The system call ring is not
+//      inherited.
+//
+//	\param parent is the process to copy
+//      \param err: error code NoError if OK. On error, the process
+//             has no address space and must be deleted by the caller
+*/
+//----------------------------------------------------------------------
+Process::Process(Process *parent, int *err)
+{
+  numThreads=0;
+  ring = NULL;
+  *err = NoError;
+  DEBUG('t', (char *)"Fork process %s\n", parent->getName());
+
+  // Create a statistics object for the program
+  stat = g_stats->NewProcStat(parent->getName());
+
+  // Set process name
+  name = new char[strlen(parent->getName())+1];
+  strcpy(name, parent->getName());
+
+  // Processes with mapped files cannot be forked. The name is kept,
+  // so that the caller can delete the process
+  exec_file = NULL;
+  addrspace = NULL;
+  if (parent->addrspace->NumMappedFiles() > 0) {
+    *err = ForkMappedFiles;
+    return;
+  }
+
+  // Open the executable of the parent again (its header, not its
+  // name, which may have been removed or reused): pages not loaded
+  // yet are read from it
+  if (parent->exec_file != NULL)
+    exec_file = new OpenFile(parent->exec_file->GetHeaderSector());
+
+  addrspace = new AddrSpace(parent->addrspace, this, err);
+  if (*err != NoError)
+    {
+      delete addrspace;
+      addrspace = NULL;
+      delete exec_file;
+      exec_file = NULL;
+      return;
+    }
+}
+
 //----------------------------------------------------------------------
 // Process::~Process
 //!   Destructor. De-alloate a process and all its components
@@ -77,6 +131,8 @@ Process::~Process()
 {
   ASSERT(numThreads==0);
 
+  delete ring;
+
   // Delete the address space. Done for all processes, even the one created
   // for startup, for which there is no executable file attached
   delete addrspace;
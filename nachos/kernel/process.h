@@ -18,6 +18,7 @@
 class AddrSpace;
 class Thread;
 class Semaphore;
+class SyscallRing;
 
 /*! \brief Defines the data structures to keep track of the execution
  environment of a user program */
@@ -29,6 +30,12 @@ public:
    */
   Process(char *filename, int *err);
 
+  /*!
+   * Create a copy of process parent (for Fork), sharing its memory
+   * copy-on-write, without any thread in it.
+   */
+  Process(Process *parent, int *err);
+
   /*! Process destructor */
   ~Process();	
 
@@ -43,6 +50,9 @@ public:
   ProcessStat *stat;                  /*!< Statistics concerning this
                                         process */
 
+  SyscallRing *ring;                  /*!< System call ring, NULL until
+                                        RingSetup is called */
+
   char * getName() {return(name);}    /*!< Returns the process name */
 
 private:
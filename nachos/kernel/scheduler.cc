@@ -11,7 +11,8 @@ thread.
 //	end up calling FindNextToRun(), and that would put us in an
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
+// 	Strict priorities: the ready thread with the highest (effective)
+//	priority runs first, FIFO among threads of the same priority.
 */
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -23,34 +24,44 @@ thread.
 
 //----------------------------------------------------------------------
 //  Scheduler::Scheduler
-/*! 	Constructor. Initialize the list of ready but not
+/*! 	Constructor. Initialize the lists of ready but not
 //      running threads to empty.
 */
 //----------------------------------------------------------------------
 Scheduler::Scheduler() {
-	readyList = new Listint;
+	for (int i = 0; i < NUM_PRIORITIES; i++)
+		readyList[i] = new IntrusiveList<Thread>(&Thread::queueHook);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-/*! 	Destructor. De-allocate the list of ready threads.
+/*! 	Destructor. De-allocate the lists of ready threads.
 */
 //----------------------------------------------------------------------
 Scheduler::~Scheduler() {
-	delete readyList;
+	for (int i = 0; i < NUM_PRIORITIES; i++)
+		delete readyList[i];
 }
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 /*! 	Mark a thread as ready, but not necessarily running yet.
-//	Put it in the ready list, for later scheduling onto the CPU.
+//	Put it in the ready list of its priority, for later scheduling
+//	onto the CPU.
+//
+//	When an interrupt handler wakes up a thread of higher priority
+//	than the interrupted one, the interrupted thread is preempted on
+//	return from the handler.
 //
 //	\param thread is the thread to be put on the ready list.
 */
 //----------------------------------------------------------------------
 void Scheduler::ReadyToRun(Thread *thread) {
 	DEBUG('t', (char *)"Putting thread %s in ready list.\n", thread->GetName());
-	readyList->Append((void *)thread);
+	readyList[thread->priority]->Append(thread);
+	if (g_machine->interrupt->InHandler() && g_current_thread != NULL
+		&& thread->priority > g_current_thread->priority)
+		g_machine->interrupt->YieldOnReturn();
 }
 
 //----------------------------------------------------------------------
@@ -63,8 +74,46 @@ void Scheduler::ReadyToRun(Thread *thread) {
 */
 //----------------------------------------------------------------------
 Thread *Scheduler::FindNextToRun() {
-	Thread *thread = (Thread *)readyList->Remove();
-	return thread;
+	for (int i = NUM_PRIORITIES - 1; i >= 0; i--)
+		if (!readyList[i]->IsEmpty())
+			return readyList[i]->Remove();
+	return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PutBack
+/*! 	Put a thread returned by FindNextToRun back on the ready list,
+//	at the head of the queue of its priority, when it is not run
+//	after all. Its turn is thus kept.
+//
+//	\param thread is the thread to put back on the ready list.
+*/
+//----------------------------------------------------------------------
+void Scheduler::PutBack(Thread *thread) {
+	readyList[thread->priority]->Prepend(thread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ChangePriority
+/*! 	Set the effective priority of a thread. If the thread is on the
+//	ready list, it is moved to the queue of its new priority.
+//
+//	\param thread is the thread whose priority changes
+//	\param priority is its new effective priority
+*/
+//----------------------------------------------------------------------
+void Scheduler::ChangePriority(Thread *thread, int priority) {
+	ASSERT(priority >= 0 && priority < NUM_PRIORITIES);
+	if (thread->priority == priority)
+		return;
+	DEBUG('t', (char *)"Priority of thread %s: %d -> %d\n", thread->GetName(),
+		  thread->priority, priority);
+	if (readyList[thread->priority]->Contains(thread)) {
+		readyList[thread->priority]->RemoveItem(thread);
+		thread->priority = priority;
+		readyList[priority]->Append(thread);
+	} else
+		thread->priority = priority;
 }
 
 //----------------------------------------------------------------------
@@ -132,6 +181,7 @@ void Scheduler::SwitchTo(Thread *nextThread) {
 //----------------------------------------------------------------------
 void Scheduler::Print() {
 	printf("Ready list contents: [");
-	readyList->Mapcar((VoidFunctionPtr)ThreadPrint);
+	for (int i = NUM_PRIORITIES - 1; i >= 0; i--)
+		readyList[i]->Mapcar((VoidFunctionPtr)ThreadPrint);
 	printf("]\n");
 }
@@ -17,10 +17,16 @@
 #define SCHEDULER_H
 
 #include "kernel/copyright.h"
-#include "utility/list.h"
+#include "utility/intrusivelist.h"
 
 class Thread;
 
+//! Number of thread priorities, from 0 (lowest) to NUM_PRIORITIES-1
+#define NUM_PRIORITIES 8
+
+//! Priority given to new threads
+#define DEFAULT_PRIORITY 0
+
 class Scheduler {
 public:
   
@@ -35,6 +41,12 @@ public:
     
   //! Dequeue first thread of the ready list, if any, and return thread. 
   Thread* FindNextToRun();
+
+  //! Put back a thread returned by FindNextToRun at the head of its queue
+  void PutBack(Thread* thread);
+
+  //! Change the effective priority of a thread, ready or not
+  void ChangePriority(Thread* thread, int priority);
     		
   //! Causes a context switch to nextThread
   void SwitchTo(Thread* nextThread);
@@ -43,8 +55,9 @@ public:
   void Print();
 
 protected:  
-  //! Queue of threads that are ready to run,but not running.
-  Listint *readyList;
+  //! Queues of threads that are ready to run, but not running,
+  //  one per priority.
+  IntrusiveList<Thread> *readyList[NUM_PRIORITIES];
 };
 
 #endif // SCHEDULER_H
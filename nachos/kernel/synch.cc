@@ -37,7 +37,7 @@ Semaphore::Semaphore(char *debugName, int initialValue) {
 	name = new char[strlen(debugName) + 1];
 	strcpy(name, debugName);
 	value = initialValue;
-	queue = new Listint;
+	queue = new IntrusiveList<Thread>(&Thread::queueHook);
 	typeId = SEMAPHORE_TYPE_ID;
 }
 
@@ -52,9 +52,8 @@ Semaphore::~Semaphore() {
 	if (!queue->IsEmpty()) {
 		DEBUG('s', (char *)"Destructor of semaphore \"%s\", queue is not empty!!\n",
 			  name);
-		Thread *t = (Thread *)queue->Remove();
-		DEBUG('s', (char *)"Queue contents %s\n", t->GetName());
-		queue->Append((void *)t);
+		DEBUG('s', (char *)"Queue contents %s\n",
+			  queue->getFirst()->GetName());
 	}
 	ASSERT(queue->IsEmpty());
 	delete[] name;
@@ -92,6 +91,38 @@ void Semaphore::P() {
 #endif
 }
 
+//----------------------------------------------------------------------
+// Semaphore::PTimed
+/*!
+//      Same as P, but wait at most ticks units of simulated time for
+//	the value to become > 0. The delay is enforced by an alarm in
+//	the pending interrupt list (see Thread::TimedSleep), so a
+//	blocked thread costs nothing until it is woken up.
+//
+//	\param ticks maximum waiting time, 0 to only test the value
+//	\return true if the semaphore was taken, false on timeout
+*/
+//----------------------------------------------------------------------
+bool Semaphore::PTimed(int ticks) {
+	bool taken = true;
+
+	DEBUG('s', (char*)"Semaphore::PTimed(%s, %d) by %s\n", name, ticks,
+		  g_current_thread->GetName());
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+	if (value <= 0) {
+	  if (ticks <= 0)
+	    taken = false;
+	  else
+	    taken = g_current_thread->TimedSleep(queue, ticks);
+	}
+	if (taken)
+	  value--;
+
+	g_machine->interrupt->SetStatus(oldLevel);
+	return taken;
+}
+
 //----------------------------------------------------------------------
 // Semaphore::V
 /*! 	Increment semaphore value, waking up a waiting thread if any.
@@ -110,11 +141,15 @@ void Semaphore::V() {
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 	value++;
-	if (!queue->IsEmpty()) {
-		Thread *t = (Thread *)queue->Remove();
+	Thread *t = queue->Remove();
+	if (t != NULL)
 		g_scheduler->ReadyToRun(t);
-	}
 	g_machine->interrupt->SetStatus(oldLevel);
+	// Let a woken up thread of higher priority run at once (when called
+	// from an interrupt handler, ReadyToRun already asked for it)
+	if (t != NULL && oldLevel == INTERRUPTS_ON
+		&& t->GetPriority() > g_current_thread->GetPriority())
+		g_current_thread->Yield();
 #endif
 }
 
@@ -128,7 +163,7 @@ void Semaphore::V() {
 Lock::Lock(char *debugName) {
 	name = new char[strlen(debugName) + 1];
 	strcpy(name, debugName);
-	sleepqueue = new Listint;
+	sleepqueue = new IntrusiveList<Thread>(&Thread::queueHook);
 	free = true;
 	owner = NULL;
 	typeId = LOCK_TYPE_ID;
@@ -143,6 +178,8 @@ Lock::Lock(char *debugName) {
 Lock::~Lock() {
 	typeId = INVALID_TYPE_ID;
 	ASSERT(sleepqueue->IsEmpty());
+	if (owner != NULL)
+		owner->heldLocks->RemoveItem(this);
 	delete[] name;
 	delete sleepqueue;
 }
@@ -156,6 +193,10 @@ Lock::~Lock() {
 //
 //	Note that Thread::Sleep assumes that interrupts are disabled
 //	when it is called.
+//
+//	To bound priority inversion, a thread blocking on the lock gives
+//	its priority to the owner, and transitively to the owner of the
+//	lock this owner is itself blocked on.
 */
 //----------------------------------------------------------------------
 void Lock::Acquire() {
@@ -168,11 +209,22 @@ void Lock::Acquire() {
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 	if (!free) {
+		int prio = g_current_thread->GetPriority();
+		Thread *o = owner;
+		for (int depth = 0; o != NULL && o->GetPriority() < prio
+				 && depth < MAX_INHERITANCE_DEPTH; depth++) {
+			g_scheduler->ChangePriority(o, prio);
+			o = (o->waitingFor != NULL) ? o->waitingFor->owner : NULL;
+		}
+		g_current_thread->waitingFor = this;
 		sleepqueue->Append(g_current_thread);
 		g_current_thread->Sleep();
+		// Release gave us the lock
+		ASSERT(owner == g_current_thread);
 	} else {
 		owner = g_current_thread;
 		free = false;
+		owner->heldLocks->Append(this);
 	}
 	g_machine->interrupt->SetStatus(oldLevel);
 #endif
@@ -185,6 +237,11 @@ void Lock::Acquire() {
 //	As with Acquire, this operation must be atomic, so we need to disable
 //	interrupts.  Scheduler::ReadyToRun() assumes that threads
 //	are disabled when it is called.
+//
+//	The lock is handed over to the waiter of highest priority (FIFO
+//	among equals), and the releasing thread gets back the priority it
+//	had without this lock. If the new owner has a higher priority, it
+//	runs at once.
 */
 //----------------------------------------------------------------------
 void Lock::Release() {
@@ -197,15 +254,28 @@ void Lock::Release() {
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 	ASSERT(isHeldByCurrentThread());
-	if (!sleepqueue->IsEmpty()) {
-		Thread *t = (Thread *)sleepqueue->Remove();
-		g_scheduler->ReadyToRun(t);
+	Thread *t = sleepqueue->getFirst();
+	for (Thread *w = t; w != NULL; w = sleepqueue->getNext(w))
+		if (w->GetPriority() > t->GetPriority())
+			t = w;
+	g_current_thread->heldLocks->RemoveItem(this);
+	if (t != NULL) {
+		sleepqueue->RemoveItem(t);
 		owner = t;
+		t->waitingFor = NULL;
+		t->heldLocks->Append(this);
+		// Inherit from the threads still waiting
+		t->UpdatePriority();
+		g_scheduler->ReadyToRun(t);
 	} else {
 		free = true;
 		owner = NULL;
 	}
+	g_current_thread->UpdatePriority();
 	g_machine->interrupt->SetStatus(oldLevel);
+	if (t != NULL && oldLevel == INTERRUPTS_ON
+		&& t->GetPriority() > g_current_thread->GetPriority())
+		g_current_thread->Yield();
 #endif
 }
 
@@ -218,6 +288,22 @@ bool Lock::isHeldByCurrentThread() {
 	return (g_current_thread == owner);
 }
 
+//----------------------------------------------------------------------
+// Lock::MaxWaiterPriority
+/*! \return the highest effective priority of the threads waiting
+//	for the lock, -1 if there are none
+*/
+//----------------------------------------------------------------------
+int Lock::MaxWaiterPriority() {
+	int p = -1;
+
+	for (Thread *w = sleepqueue->getFirst(); w != NULL;
+		 w = sleepqueue->getNext(w))
+		if (w->GetPriority() > p)
+			p = w->GetPriority();
+	return p;
+}
+
 //----------------------------------------------------------------------
 // Condition::Condition
 /*! 	Initializes a Condition, so that it can be used for synchronization.
@@ -228,7 +314,7 @@ bool Lock::isHeldByCurrentThread() {
 Condition::Condition(char *debugName) {
 	name = new char[strlen(debugName) + 1];
 	strcpy(name, debugName);
-	waitqueue = new Listint;
+	waitqueue = new IntrusiveList<Thread>(&Thread::queueHook);
 	typeId = CONDITION_TYPE_ID;
 }
 
@@ -259,6 +345,7 @@ void Condition::Wait() {
 #ifdef ETUDIANTS_TP
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	waitqueue->Append(g_current_thread);
 	g_current_thread->Sleep();
 	g_machine->interrupt->SetStatus(oldLevel);
 #endif
@@ -280,7 +367,7 @@ void Condition::Signal() {
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 	if (!waitqueue->IsEmpty()) {
-	  Thread *t = (Thread *)waitqueue->Remove();
+	  Thread *t = waitqueue->Remove();
 	  g_scheduler->ReadyToRun(t);
 	}
 	g_machine->interrupt->SetStatus(oldLevel);
@@ -302,9 +389,155 @@ void Condition::Broadcast() {
 	IntStatus oldLevel = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 	while (!waitqueue->IsEmpty()) {
-	  Thread *t = (Thread *)waitqueue->Remove();
+	  Thread *t = waitqueue->Remove();
 	  g_scheduler->ReadyToRun(t);
 	}
 	g_machine->interrupt->SetStatus(oldLevel);
 #endif
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+/*! 	Initialize a reader-writer lock, initially free.
+//
+//    \param  "debugName" is an arbitrary name, useful for debugging.
+*/
+//----------------------------------------------------------------------
+RWLock::RWLock(char *debugName) {
+	name = new char[strlen(debugName) + 1];
+	strcpy(name, debugName);
+	readers = 0;
+	writer = NULL;
+	readqueue = new IntrusiveList<Thread>(&Thread::queueHook);
+	writequeue = new IntrusiveList<Thread>(&Thread::queueHook);
+	typeId = RWLOCK_TYPE_ID;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+/*! 	De-allocate a reader-writer lock, when no longer needed.
+//      Assumes that no thread is waiting on the lock.
+*/
+//----------------------------------------------------------------------
+RWLock::~RWLock() {
+	typeId = INVALID_TYPE_ID;
+	ASSERT(readqueue->IsEmpty() && writequeue->IsEmpty());
+	delete[] name;
+	delete readqueue;
+	delete writequeue;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+/*! 	Wait until the lock can be held in shared mode: no writer holds
+//	it, and no writer waits for it.
+*/
+//----------------------------------------------------------------------
+void RWLock::AcquireRead() {
+	DEBUG('s', (char*)"RWLock::AcquireRead(%s) by %s\n", name, g_current_thread->GetName());
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	if (writer != NULL || !writequeue->IsEmpty()) {
+		readqueue->Append(g_current_thread);
+		g_current_thread->Sleep();  // readers was incremented by the waker
+	} else
+		readers++;
+	g_machine->interrupt->SetStatus(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+/*! 	Wait until the lock is held by nobody, then hold it exclusively.
+*/
+//----------------------------------------------------------------------
+void RWLock::AcquireWrite() {
+	DEBUG('s', (char*)"RWLock::AcquireWrite(%s) by %s\n", name, g_current_thread->GetName());
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	if (writer != NULL || readers > 0) {
+		writequeue->Append(g_current_thread);
+		g_current_thread->Sleep();  // writer was set by the waker
+	} else
+		writer = g_current_thread;
+	g_machine->interrupt->SetStatus(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::Release
+/*! 	Release the lock held by the current thread. When the last reader
+//	leaves, the lock is handed to the first waiting writer. When a
+//	writer leaves, it is handed to the first waiting writer if any,
+//	otherwise to all the waiting readers at once.
+*/
+//----------------------------------------------------------------------
+void RWLock::Release() {
+	DEBUG('s', (char*)"RWLock::Release(%s) by %s\n", name, g_current_thread->GetName());
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	if (writer == g_current_thread)
+		writer = NULL;
+	else {
+		ASSERT(readers > 0);
+		readers--;
+	}
+	if (writer == NULL && readers == 0) {
+		if (!writequeue->IsEmpty()) {
+			writer = writequeue->Remove();
+			g_scheduler->ReadyToRun(writer);
+		} else {
+			while (!readqueue->IsEmpty()) {
+				readers++;
+				g_scheduler->ReadyToRun(readqueue->Remove());
+			}
+		}
+	}
+	g_machine->interrupt->SetStatus(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Barrier::Barrier
+/*! 	Initialize a barrier for count threads.
+//
+//    \param  "debugName" is an arbitrary name, useful for debugging.
+//    \param  count is the number of threads the barrier waits for.
+*/
+//----------------------------------------------------------------------
+Barrier::Barrier(char *debugName, int initialCount) {
+	name = new char[strlen(debugName) + 1];
+	strcpy(name, debugName);
+	count = initialCount;
+	arrived = 0;
+	waitqueue = new IntrusiveList<Thread>(&Thread::queueHook);
+	typeId = BARRIER_TYPE_ID;
+}
+
+//----------------------------------------------------------------------
+// Barrier::~Barrier
+/*! 	De-allocate a barrier, when no longer needed.
+//      Assumes that no thread is waiting on the barrier.
+*/
+//----------------------------------------------------------------------
+Barrier::~Barrier() {
+	typeId = INVALID_TYPE_ID;
+	ASSERT(waitqueue->IsEmpty());
+	delete[] name;
+	delete waitqueue;
+}
+
+//----------------------------------------------------------------------
+// Barrier::Wait
+/*! 	Block until count threads have reached the barrier. The last
+//	thread to arrive wakes up all the others and starts a new phase.
+*/
+//----------------------------------------------------------------------
+void Barrier::Wait() {
+	DEBUG('s', (char*)"Barrier::Wait(%s) by %s\n", name, g_current_thread->GetName());
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	arrived++;
+	if (arrived < count) {
+		waitqueue->Append(g_current_thread);
+		g_current_thread->Sleep();
+	} else {
+		arrived = 0;
+		while (!waitqueue->IsEmpty())
+			g_scheduler->ReadyToRun(waitqueue->Remove());
+	}
+	g_machine->interrupt->SetStatus(oldLevel);
+}
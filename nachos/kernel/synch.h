@@ -19,7 +19,7 @@
 #include "kernel/copyright.h"
 #include "kernel/system.h"
 #include "kernel/thread.h"
-#include "utility/list.h"
+#include "utility/intrusivelist.h"
 
 /*! \brief Defines the "semaphore" synchronization tool
 //
@@ -50,11 +50,14 @@ public:
     
   void P();	 // these are the only operations on a semaphore
   void V();	 // they are both *atomic*
+
+  //! P giving up after ticks (return false if the value was not taken)
+  bool PTimed(int ticks);
     
 private:
   char *name;      //!< useful for debugging
   int value;       //!< semaphore value
-  Listint *queue;  //!< threads waiting in P() for the value to be > 0
+  IntrusiveList<Thread> *queue;  //!< threads waiting in P() for the value to be > 0
 
 public:
   //! signature to make sure the semaphore is in the correct state
@@ -75,6 +78,9 @@ public:
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
 */
+//! Maximum length of a chain of locks along which a priority is inherited
+#define MAX_INHERITANCE_DEPTH 8
+
 class Lock {
 public:
   //! Lock creation
@@ -95,10 +101,16 @@ public:
   //! true if the current thread holds this lock.  Useful for checking
   //! in Release, and in Condition variable operations below.
   bool isHeldByCurrentThread();	 
+
+  //! Highest priority of the threads waiting for the lock (-1 if none)
+  int MaxWaiterPriority();
+
+  //! Links in the list of locks held by the owner
+  ListHook<Lock> heldHook;
   
 private:
   char* name;            //!< for debugging
-  Listint * sleepqueue;  //!< threads waiting to acquire the lock
+  IntrusiveList<Thread> *sleepqueue;  //!< threads waiting to acquire the lock
   bool free;             //!< to know if the lock is free
   Thread * owner;        //!< Thread who has acquired the lock
 
@@ -140,11 +152,86 @@ public:
 
 private:
   char* name;           //!< For debbuging
-  Listint * waitqueue;  //!< Threads asked to wait
+  IntrusiveList<Thread> *waitqueue;  //!< Threads asked to wait
 
 public:
   //! Signature to make sure the condition is in the correct state
   ObjectTypeId typeId;
 };
 
+/*! \brief Defines the "reader-writer lock" synchronization tool
+//
+// A reader-writer lock can be held either by any number of readers, or
+// by a single writer:
+//
+//	AcquireRead -- wait until no writer holds or waits for the lock,
+//	               then become one of its readers
+//
+//	AcquireWrite -- wait until nobody holds the lock, then hold it
+//	                exclusively
+//
+//	Release -- release the lock held by the current thread (in read or
+//	           write mode), waking up waiters if necessary
+//
+// Waiting writers have priority over new readers, so that writers are
+// not starved. As for Lock, the lock is handed off to the threads it
+// wakes up: they do not have to compete for it again.
+*/
+class RWLock {
+public:
+  //! Reader-writer lock creation
+  RWLock(char* debugName);
+
+  //! Delete a reader-writer lock
+  ~RWLock();
+
+  //! For debugging
+  char* getName() { return name; }
+
+  void AcquireRead();   // Acquire the lock in shared mode (atomic)
+  void AcquireWrite();  // Acquire the lock in exclusive mode (atomic)
+  void Release();       // Release the lock, in either mode (atomic)
+
+private:
+  char* name;                          //!< for debugging
+  int readers;                         //!< number of readers holding the lock
+  Thread *writer;                      //!< writer holding the lock, if any
+  IntrusiveList<Thread> *readqueue;    //!< readers waiting for the lock
+  IntrusiveList<Thread> *writequeue;   //!< writers waiting for the lock
+
+public:
+  //! signature to make sure the lock is in the correct state
+  ObjectTypeId typeId;
+};
+
+/*! \brief Defines the "barrier" synchronization tool
+//
+// A barrier blocks the threads calling Wait() until "count" of them have
+// arrived. The last one releases all the others in a single pass over
+// the wait queue, and the barrier can then be reused for the next phase.
+*/
+class Barrier {
+public:
+  //! Create a barrier for count threads
+  Barrier(char* debugName, int count);
+
+  //! Delete a barrier
+  ~Barrier();
+
+  //! For debugging
+  char* getName() { return name; }
+
+  void Wait();  // Wait until count threads have called Wait (atomic)
+
+private:
+  char* name;                        //!< for debugging
+  int count;                         //!< number of threads to wait for
+  int arrived;                       //!< threads arrived in the current phase
+  IntrusiveList<Thread> *waitqueue;  //!< threads waiting for the others
+
+public:
+  //! signature to make sure the barrier is in the correct state
+  ObjectTypeId typeId;
+};
+
 #endif // SYNCH_H
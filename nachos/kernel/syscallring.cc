@@ -0,0 +1,191 @@
+/*! \file syscallring.cc
+//  \brief Routines executing the batches of the system call ring.
+//
+//  Operations are executed in submission order, with the same
+//  semantics as the corresponding system calls: a P on a semaphore
+//  whose value is 0 blocks the whole batch.
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.
+//  See copyright_insa.h for copyright notice and limitation
+//  of liability and disclaimer of warranty provisions.
+*/
+
+#include <stddef.h>
+
+#include "drivers/drvConsole.h"
+#include "filesys/openfile.h"
+#include "kernel/synch.h"
+#include "kernel/syscallring.h"
+#include "kernel/system.h"
+#include "machine/machine.h"
+#include "userlib/syscall.h"
+#include "utility/objid.h"
+
+//! Byte offset of field in the RingPage
+#define RING_OFFSET(field) ((int)offsetof(RingPage, field))
+
+//----------------------------------------------------------------------
+// SyscallRing::SyscallRing
+/*! 	Attach the kernel side of the ring to a RingPage of the current
+//	process. The page must be zero-filled: both queues start empty.
+//
+//	\param addr virtual address of the RingPage
+*/
+//----------------------------------------------------------------------
+SyscallRing::SyscallRing(int32_t addr) {
+	base = addr;
+	sqHead = 0;
+	cqTail = 0;
+}
+
+//----------------------------------------------------------------------
+// SyscallRing::ReadWord, SyscallRing::WriteWord
+/*! 	Access a word of the RingPage in the memory of the current
+//	process (may page fault).
+//
+//	\return false if the address is invalid
+*/
+//----------------------------------------------------------------------
+bool SyscallRing::ReadWord(int offset, int *value) {
+	return g_machine->mmu->ReadMem(base + offset, 4, value, false);
+}
+
+bool SyscallRing::WriteWord(int offset, int value) {
+	return g_machine->mmu->WriteMem(base + offset, 4, value);
+}
+
+//----------------------------------------------------------------------
+// SyscallRing::Enter
+/*! 	Execute the submissions queued since the last call, in order,
+//	and post their results in the completion queue. The kernel stops
+//	when count submissions were executed, when the submission queue
+//	is empty, or when the completion queue is full (the remaining
+//	submissions are left for the next call).
+//
+//	sq_head is published before executing each submission, so the
+//	user may re-use its slot while the operation blocks.
+//
+//	\param count maximum number of submissions to execute, or <= 0
+//		to execute all of them
+//	\return the number of submissions executed, -1 if the indexes
+//		of the ring are inconsistent
+*/
+//----------------------------------------------------------------------
+int SyscallRing::Enter(int count) {
+	int sqTail, cqHead;
+	int done = 0;
+
+	if (!ReadWord(RING_OFFSET(sq_tail), &sqTail)
+		|| !ReadWord(RING_OFFSET(cq_head), &cqHead))
+		return -1;
+	if (sqTail - sqHead < 0 || sqTail - sqHead > RING_ENTRIES
+		|| cqTail - cqHead < 0 || cqTail - cqHead > RING_ENTRIES)
+		return -1;
+
+	while (sqHead != sqTail && (count <= 0 || done < count)
+		   && cqTail - cqHead < RING_ENTRIES) {
+		int sqe = RING_OFFSET(sq) + (sqHead % RING_ENTRIES) * sizeof(RingSqe);
+		int opcode, userData;
+		int32_t arg[3];
+
+		if (!ReadWord(sqe + offsetof(RingSqe, opcode), &opcode)
+			|| !ReadWord(sqe + offsetof(RingSqe, user_data), &userData))
+			return -1;
+		for (int i = 0; i < 3; i++)
+			if (!ReadWord(sqe + offsetof(RingSqe, arg) + i * 4, &arg[i]))
+				return -1;
+		sqHead++;
+		WriteWord(RING_OFFSET(sq_head), sqHead);
+
+		int result = Execute(opcode, arg);
+
+		int cqe = RING_OFFSET(cq) + (cqTail % RING_ENTRIES) * sizeof(RingCqe);
+		WriteWord(cqe + offsetof(RingCqe, user_data), userData);
+		WriteWord(cqe + offsetof(RingCqe, result), result);
+		cqTail++;
+		WriteWord(RING_OFFSET(cq_tail), cqTail);
+		done++;
+	}
+	DEBUG('e', (char *)"Ring: %d operation(s) executed in one trap\n", done);
+	return done;
+}
+
+//----------------------------------------------------------------------
+// SyscallRing::Execute
+/*! 	Execute one submission of the ring.
+//
+//	\param opcode operation (RING_OP_xxx)
+//	\param arg arguments, as for the corresponding system call
+//	\return the value the system call would have returned
+*/
+//----------------------------------------------------------------------
+int SyscallRing::Execute(int opcode, int32_t *arg) {
+	switch (opcode) {
+	case RING_OP_NOP:
+		return 0;
+
+	case RING_OP_READ: {
+		int32_t addr = arg[0];
+		int size = arg[1];
+		int32_t f = arg[2];
+		int numread;
+
+		if (size < 0)
+			return -1;
+		char buffer[size];
+		if (f != ConsoleInput) {
+			OpenFile *file = (OpenFile *)g_object_ids->SearchObject(f);
+			if (!file || file->typeId != FILE_TYPE_ID)
+				return -1;
+			numread = file->Read(buffer, size);
+		} else {
+			g_console_driver->GetString(buffer, size);
+			numread = size;
+		}
+		for (int i = 0; i < numread; i++)
+			g_machine->mmu->WriteMem(addr++, 1, buffer[i]);
+		return numread;
+	}
+
+	case RING_OP_WRITE: {
+		int32_t addr = arg[0];
+		int size = arg[1];
+		int32_t f = arg[2];
+		int c;
+
+		if (size < 0)
+			return -1;
+		char buffer[size];
+		for (int i = 0; i < size; i++) {
+			g_machine->mmu->ReadMem(addr++, 1, &c, false);
+			buffer[i] = c;
+		}
+		if (f > ConsoleOutput) {
+			OpenFile *file = (OpenFile *)g_object_ids->SearchObject(f);
+			if (!file || file->typeId != FILE_TYPE_ID)
+				return -1;
+			return file->Write(buffer, size);
+		}
+		if (f != ConsoleOutput)
+			return -1;
+		g_console_driver->PutString(buffer, size);
+		return size;
+	}
+
+	case RING_OP_P:
+	case RING_OP_V: {
+		Semaphore *sema = (Semaphore *)g_object_ids->SearchObject(arg[0]);
+		if (!sema || sema->typeId != SEMAPHORE_TYPE_ID)
+			return -1;
+		if (opcode == RING_OP_P)
+			sema->P();
+		else
+			sema->V();
+		return 0;
+	}
+
+	default:
+		return -1;
+	}
+}
@@ -0,0 +1,54 @@
+/*! \file syscallring.h
+    \brief Data structures for batched system calls
+
+    The system call ring of a process is a RingPage (see
+    userlib/syscall.h) allocated in its address space: the user queues
+    Read, Write, P and V operations in the submission queue, and a
+    single RingEnter trap executes the whole batch, posting one result
+    per operation in the completion queue. The cost of the trap is thus
+    shared by all the operations of the batch.
+
+    The indexes of the ring are in user memory and may be modified at
+    any time by the process, so the kernel keeps its own copy of the
+    indexes it owns (sq_head, cq_tail) and never trusts the user ones
+    beyond the number of entries of the ring.
+
+    Copyright (c) 1999-2000 INSA de Rennes.
+    All rights reserved.
+    See copyright_insa.h for copyright notice and limitation
+    of liability and disclaimer of warranty provisions.
+*/
+
+#ifndef SYSCALLRING_H
+#define SYSCALLRING_H
+
+#include "kernel/copyright.h"
+#include "utility/utility.h"
+
+/*! \brief Defines the kernel side of the system call ring of a process
+*/
+class SyscallRing {
+public:
+  //! Attach to a RingPage at virtual address addr of the current process
+  SyscallRing(int32_t addr);
+
+  //! Virtual address of the RingPage
+  int32_t GetAddr() { return base; }
+
+  //! Execute at most count queued submissions (all if count <= 0)
+  int Enter(int count);
+
+private:
+  //! Execute one submission, return its result
+  int Execute(int opcode, int32_t *arg);
+
+  //! Read / write a word of the RingPage at byte offset offset
+  bool ReadWord(int offset, int *value);
+  bool WriteWord(int offset, int value);
+
+  int32_t base;   //!< Virtual address of the RingPage
+  int sqHead;     //!< Next submission to execute
+  int cqTail;     //!< Next completion slot to fill
+};
+
+#endif // SYSCALLRING_H
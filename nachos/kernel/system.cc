@@ -8,6 +8,8 @@
 #include "kernel/system.h"
 #include "kernel/thread.h"
 #include "kernel/scheduler.h"
+#include "kernel/futex.h"
+#include "vm/pagewait.h"
 #include "kernel/msgerror.h"
 #include "drivers/drvConsole.h"
 #include "drivers/drvDisk.h"
@@ -20,6 +22,7 @@
 #include "vm/physMem.h"
 #include "filesys/oftable.h"
 #include "filesys/filesys.h"
+#include "filesys/namecache.h"
 #include "utility/objid.h"
 
 /*!  This defines *all* of the global data structures used by Nachos.
@@ -33,8 +36,10 @@ Machine* g_machine;	                //!< Machine (includes CPU and peripherals)
 // Thread management
 Thread *g_current_thread;		//!< The thread holding the CPU
 Thread *g_thread_to_be_destroyed;  	//!< The thread that just finished
-Listint *g_alive;                        //!< List of existing threads
+IntrusiveList<Thread> *g_alive;          //!< List of existing threads
 Scheduler *g_scheduler;			//!< Thread scheduler
+FutexTable *g_futex_table;              //!< Wait queues of user futexes
+PageWaitTable *g_page_waits;            //!< Wait queues of pages under I/O
 
 // Device drivers
 DriverDisk *g_disk_driver;               //!< Disk driver
@@ -150,12 +155,15 @@ Initialize(int argc, char **argv)
   g_machine = new Machine(debugUserProg);
 
   // Create the device drivers
-  g_disk_driver = new DriverDisk("sem disk","lock disk",g_machine->disk);
+  g_disk_driver = new DriverDisk("sem disk","lock disk",g_machine->disk,
+				 g_cfg->DiskCacheSize);
   if (g_cfg->ACIA) g_acia_driver = new DriverACIA();
   g_console_driver = new DriverConsole();
 
   // Create the different objects making the Nachos kernel
   g_scheduler = new Scheduler();		// Initialize the ready queue
+  g_futex_table = new FutexTable();	// No thread blocked on a futex
+  g_page_waits = new PageWaitTable();	// No thread waiting for a page
   g_page_fault_manager = new PageFaultManager();
   g_swap_manager = new SwapManager();
   g_swap_disk_driver = g_swap_manager->GetSwapDisk();
@@ -163,7 +171,7 @@ Initialize(int argc, char **argv)
   g_syscall_error = new SyscallError();
 
   // Init the Nachos internal data structures
-  g_alive = new Listint();                // List of threads (initially empty)
+  g_alive = new IntrusiveList<Thread>(&Thread::aliveHook); // List of threads (initially empty)
   g_object_ids = new ObjId();              // List of objects (initially empty)
   g_thread_to_be_destroyed = NULL;
   g_open_file_table = new OpenFileTable;
@@ -177,7 +185,7 @@ Initialize(int argc, char **argv)
   // It's just a temporary thread
   
   // Create the process (address space + statistics) context for this temporary thread
-  Process *rootProcess = new Process(NULL,&errStatus);
+  Process *rootProcess = new Process((char *)NULL,&errStatus);
   if (errStatus != NoError) Exit(-1);
   
   // Create the root thread 
@@ -188,6 +196,12 @@ Initialize(int argc, char **argv)
   // Remove g_current_thread from ready list (inserted by default)
   // because it is currently executing
   ASSERT(g_current_thread == g_scheduler->FindNextToRun());
+
+#ifdef ETUDIANTS_TP
+  // Start the kernel daemons
+  g_physical_mem_manager->StartCleaner(rootProcess);
+  g_disk_driver->StartFlusher(rootProcess);
+#endif
   
   // Enable interrupts
   g_machine->interrupt->SetStatus(INTERRUPTS_ON);
@@ -212,8 +226,10 @@ Cleanup()
   // because the last running thread, even if finished, is not deleted
   // yet (deletion is done in the following context switch), for the
   // last executing thread after cleanup, there is no following
-  // context switch, we have to free resources here.
-  if (g_current_thread!=NULL) {
+  // context switch, we have to free resources here. A kernel daemon
+  // that went to sleep when the machine became idle (e.g. the disk
+  // flusher) is still on a wait queue, and is left alone.
+  if (g_current_thread!=NULL && !g_current_thread->queueHook.IsLinked()) {
     delete g_current_thread;
   }
 
@@ -221,6 +237,10 @@ Cleanup()
   printf("\nCleaning up...\n");    
   if (g_cfg->PrintStat) {
     g_stats->Print();
+    g_physical_mem_manager->PrintStats();
+    g_swap_manager->PrintStats();
+    if (g_file_system != NULL)
+      g_file_system->GetNameCache()->PrintStats();
   }
   delete g_disk_driver;
   delete g_console_driver;
@@ -230,6 +250,8 @@ Cleanup()
   delete g_open_file_table;
   delete g_swap_manager;
   delete g_scheduler;
+  delete g_futex_table;
+  delete g_page_waits;
   delete g_stats;
   delete g_physical_mem_manager;
   delete g_page_fault_manager;
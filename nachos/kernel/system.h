@@ -16,6 +16,7 @@
 using namespace std;
 
 #include "utility/list.h"
+#include "utility/intrusivelist.h"
 #include "utility/objid.h"
 
 /*! Each syscall makes sure that the object that the user passes to it
@@ -26,6 +27,8 @@ typedef enum {
   SEMAPHORE_TYPE_ID = 0xdeefeaea,
   LOCK_TYPE_ID = 0xdeefcccc,
   CONDITION_TYPE_ID = 0xdeefcdcd,
+  RWLOCK_TYPE_ID = 0xdeefabab,
+  BARRIER_TYPE_ID = 0xdeefbaba,
   FILE_TYPE_ID = 0xdeadbeef,
   THREAD_TYPE_ID = 0xbadcafe,
   INVALID_TYPE_ID = 0xf0f0f0f
@@ -37,6 +40,8 @@ class Statistics;
 class SyscallError;
 class Thread;
 class Scheduler;
+class FutexTable;
+class PageWaitTable;
 class PageFaultManager;
 class PhysicalMemManager;
 class SwapManager;
@@ -62,8 +67,10 @@ extern Machine* g_machine;	                //!< Machine (includes CPU and periph
 // Thread management
 extern Thread *g_current_thread;		//!< The thread holding the CPU
 extern Thread *g_thread_to_be_destroyed;  	//!< The thread that just finished
-extern Listint *g_alive;                        //!< List of existing threads
+extern IntrusiveList<Thread> *g_alive;          //!< List of existing threads
 extern Scheduler *g_scheduler;			//!< Thread scheduler
+extern FutexTable *g_futex_table;               //!< Wait queues of user futexes
+extern PageWaitTable *g_page_waits;             //!< Wait queues of pages under I/O
 
 // Device drivers
 extern DriverDisk *g_disk_driver;               //!< Disk driver
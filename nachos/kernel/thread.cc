@@ -40,6 +40,18 @@ Thread::Thread(char *threadName) {
 
 	// No process owner yet
 	process = NULL;
+	kernelFunc = NULL;
+	kernelArg = 0;
+	futexAddr = 0;
+	stackPointer = 0;
+	waitChannel = NULL;
+	waitKey = 0;
+	wakeup = NULL;
+	timedQueue = NULL;
+	timedOut = false;
+	priority = basePriority = DEFAULT_PRIORITY;
+	waitingFor = NULL;
+	heldLocks = new IntrusiveList<Lock>(&Lock::heldHook);
 }
 
 //----------------------------------------------------------------------
@@ -57,6 +69,7 @@ Thread::Thread(char *threadName) {
 Thread::~Thread() {
 	DEBUG('t', (char *)"Deleting thread \"%s\"\n", name);
 	typeId = INVALID_TYPE_ID;
+	ASSERT(!queueHook.IsLinked());
 
 	// CheckOverflow();
 
@@ -68,14 +81,16 @@ Thread::~Thread() {
 		DeallocBoundedArray(simulator_context.stackBottom,
 							simulator_context.stackSize);
 
-	// NB: the thread stack itself is not freed, we do not attempt to
-	// reuse the address space dedicated to stack The corresponding
-	// physical memory will be deallocated when the process will be
-	// deleted
+	// NB: the user stack of the thread was released by Finish
 
 	// Protect from other accesses to the process object
 	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 
+	// A thread halting the machine is deleted without going through
+	// Finish: make sure it does not stay in the list of existing threads
+	g_alive->RemoveItem(this);
+	delete heldLocks;
+
 	// Signals to the process that we terminated
 	process->numThreads--;
 
@@ -113,7 +128,8 @@ int Thread::Start(Process *owner, int32_t func, int arg) {
   process->numThreads++;
 
   InitSimulatorContext(AllocBoundedArray(SIMULATORSTACKSIZE), SIMULATORSTACKSIZE);
-  InitThreadContext(func, process->addrspace->StackAllocate(), arg);
+  stackPointer = process->addrspace->StackAllocate();
+  InitThreadContext(func, stackPointer, arg);
 
   g_alive->Append(this);
   g_scheduler->ReadyToRun(this);
@@ -124,6 +140,99 @@ int Thread::Start(Process *owner, int32_t func, int arg) {
 #endif
 }
 
+//----------------------------------------------------------------------
+// Thread::StartKernel
+/*!	Start a kernel thread (a daemon): instead of jumping to user
+//	code, the thread calls func(arg) in the kernel, and finishes
+//	when func returns. The thread is attached to a process for the
+//	statistics and the address space (usually the boot process), but
+//	gets no user stack.
+//
+//      \param owner process the thread is attached to
+//      \param func kernel function to execute
+//      \param arg argument of func
+//
+// \return NoError on success, an error code on error
+*/
+//----------------------------------------------------------------------
+int Thread::StartKernel(Process *owner, VoidFunctionPtr func, int64_t arg) {
+  IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+  ASSERT(process == NULL);
+
+  process = owner;
+  process->numThreads++;
+  kernelFunc = func;
+  kernelArg = arg;
+
+  InitSimulatorContext(AllocBoundedArray(SIMULATORSTACKSIZE), SIMULATORSTACKSIZE);
+  InitThreadContext(0, 0, 0);
+
+  g_alive->Append(this);
+  g_scheduler->ReadyToRun(this);
+
+  g_machine->interrupt->SetStatus(oldLevel);
+
+  return NoError;
+}
+
+//----------------------------------------------------------------------
+// Thread::StartFork
+/*!	Start the thread of a process created by Fork. Its registers are
+//	copied from the current thread, which is executing the Fork
+//	system call, so that it resumes after the system call, with 0 as
+//	the result. Its user stack is the copy of the current one, at the
+//	same address.
+//
+//      \param owner process created by Fork
+//
+// \return NoError on success, an error code on error
+*/
+//----------------------------------------------------------------------
+int Thread::StartFork(Process *owner) {
+  IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+  ASSERT(process == NULL);
+
+  process = owner;
+  process->numThreads++;
+
+  InitSimulatorContext(AllocBoundedArray(SIMULATORSTACKSIZE), SIMULATORSTACKSIZE);
+
+  for (int i = 0; i < NUM_INT_REGS; i++)
+    thread_context.int_registers[i] = g_machine->int_registers[i];
+  // The FP registers are still in the thread context if the current
+  // thread did not use the FPU since it got the CPU
+  if (g_machine->fpuUsable) {
+    for (int i = 0; i < NUM_FP_REGS; i++)
+      thread_context.float_registers[i] = g_machine->float_registers[i];
+    thread_context.cc = g_machine->ReadCC();
+  } else {
+    for (int i = 0; i < NUM_FP_REGS; i++)
+      thread_context.float_registers[i] =
+	g_current_thread->thread_context.float_registers[i];
+    thread_context.cc = g_current_thread->thread_context.cc;
+  }
+
+  // Same user stack, released by the new process when the thread ends
+  stackPointer = g_current_thread->stackPointer;
+
+  // Return 0 from the system call
+  thread_context.int_registers[2] = 0;
+  thread_context.int_registers[PREVPC_REG] = thread_context.int_registers[PC_REG];
+  thread_context.int_registers[PC_REG] = thread_context.int_registers[NEXTPC_REG];
+  thread_context.int_registers[NEXTPC_REG] += 4;
+
+  SetPriority(g_current_thread->GetBasePriority());
+
+  g_alive->Append(this);
+  g_scheduler->ReadyToRun(this);
+
+  g_machine->interrupt->SetStatus(oldLevel);
+
+  return NoError;
+}
+
 //----------------------------------------------------------------------
 // Thread::InitThreadContext
 /*!	Set the initial values for the thread contact
@@ -138,6 +247,8 @@ void Thread::InitThreadContext(int32_t initialPCREG, int32_t initialSP,
 	int i;
 
 	for (i = 0; i < NUM_INT_REGS; i++) thread_context.int_registers[i] = 0;
+	for (i = 0; i < NUM_FP_REGS; i++) thread_context.float_registers[i] = 0;
+	thread_context.cc = 0;
 
 	// Initial program counter -- must be location of "Start"
 	thread_context.int_registers[PC_REG] = initialPCREG;
@@ -174,13 +285,20 @@ void StartThreadExecution(void) {
 	ASSERT(0);
 }
 
+void StartKernelThreadExecution(void) {
+	g_machine->interrupt->SetStatus(INTERRUPTS_ON);
+	(*g_current_thread->kernelFunc)(g_current_thread->kernelArg);
+	g_current_thread->Finish();
+}
+
 //----------------------------------------------------------------------
 // Thread::InitSimulatorContext
 /*!
 //
 //  Sets-up the simulator context : fills it with the appropriate
 //  values such that the low-level context switch executes function
-//  StartThreadExecution
+//  StartThreadExecution (StartKernelThreadExecution for a kernel
+//  thread)
 // 	\param base_stack_addr is the lowest address of the kernel stack
 //
 //----------------------------------------------------------------------
@@ -203,7 +321,9 @@ void Thread::InitSimulatorContext(int8_t *base_stack_addr,
 	simulator_context.buf.uc_stack.ss_size = stack_size;
 	simulator_context.buf.uc_stack.ss_flags = 0;
 	simulator_context.buf.uc_link = NULL;
-	makecontext(&simulator_context.buf, StartThreadExecution, 0);
+	makecontext(&simulator_context.buf,
+				(kernelFunc != NULL) ? StartKernelThreadExecution
+									 : StartThreadExecution, 0);
 
 	// Setup kernel stack parameters for low-level context switch
 	simulator_context.stackBottom = base_stack_addr;
@@ -222,7 +342,8 @@ void Thread::InitSimulatorContext(int8_t *base_stack_addr,
 */
 void Thread::Join(Thread *Idthread) {
 	DEBUG('t', (char *)"Joining thread \"%s\"\n", GetName());
-	while (g_alive->Search(Idthread)) Yield();
+	// The thread waited for may have a lower priority
+	while (g_alive->Search(Idthread)) Yield(true);
 }
 
 //----------------------------------------------------------------------
@@ -271,6 +392,14 @@ void Thread::Finish() {
 
 #ifdef ETUDIANTS_TP
 	DEBUG('t', (char *)"Finishing thread \"%s\"\n", GetName());
+
+	// The user stack is not used any more: its pages and its virtual
+	// area can be reused by the other threads of the process
+	if (stackPointer != 0) {
+		process->addrspace->StackRelease(stackPointer);
+		stackPointer = 0;
+	}
+
 	IntStatus oldStatus = g_machine->interrupt->GetStatus();
 	g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 
@@ -285,9 +414,12 @@ void Thread::Finish() {
 
 //----------------------------------------------------------------------
 // Thread::Yield
-/*! 	Relinquish the CPU if any other thread is ready to run.
-//	If so, put the thread on the end of the ready list, so that
-//	it will eventually be re-scheduled.
+/*! 	Relinquish the CPU if any other thread of the same or a higher
+//	priority is ready to run. If so, put the thread on the end of the
+//	ready list, so that it will eventually be re-scheduled. A thread
+//	of lower priority only gets the CPU when toLower is true: this is
+//	for busy waits on something such a thread has to do; it then
+//	runs until the next timer interrupt at most.
 //
 //	NOTE: returns immediately if no other thread on the ready queue.
 //	Otherwise returns when the thread eventually works its way
@@ -297,9 +429,12 @@ void Thread::Finish() {
 //	on the front of the ready list, and switching to it, can be done
 //	atomically.  On return, we re-set the interrupt level to its
 //	original state, in case we are called with interrupts disabled.
+//
+//	\param toLower true to give the CPU to a thread of lower priority
+//	       too
 */
 //----------------------------------------------------------------------
-void Thread::Yield() {
+void Thread::Yield(bool toLower) {
 	Thread *nextThread;
 	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
 
@@ -308,6 +443,10 @@ void Thread::Yield() {
 	DEBUG('t', (char *)"Yielding thread \"%s\"\n", GetName());
 
 	nextThread = g_scheduler->FindNextToRun();
+	if (nextThread != NULL && nextThread->priority < priority && !toLower) {
+		g_scheduler->PutBack(nextThread);
+		nextThread = NULL;
+	}
 	if (nextThread != NULL) {
 		g_scheduler->ReadyToRun(this);
 		g_scheduler->SwitchTo(nextThread);
@@ -359,6 +498,108 @@ void Thread::Sleep() {
 	g_scheduler->SwitchTo(nextThread);
 }
 
+//----------------------------------------------------------------------
+// ThreadTimeout
+/*! 	Alarm handler of Thread::TimedSleep. If the thread is still
+//	waiting, take it off its wait queue and make it runnable again,
+//	telling TimedSleep that the delay has expired.
+//
+//	\param arg is the sleeping thread
+*/
+//----------------------------------------------------------------------
+static void ThreadTimeout(int64_t arg) {
+	Thread *t = (Thread *)arg;
+
+	ASSERT(t->typeId == THREAD_TYPE_ID);
+	// The interrupt is deleted once this handler returns
+	t->wakeup = NULL;
+	if (t->timedQueue != NULL) {
+		// Already woken up by another thread, the alarm came too late
+		if (!t->timedQueue->Contains(t))
+			return;
+		t->timedQueue->RemoveItem(t);
+	}
+	DEBUG('t', (char *)"Timeout of thread \"%s\"\n", t->GetName());
+	t->timedOut = true;
+	g_scheduler->ReadyToRun(t);
+}
+
+//----------------------------------------------------------------------
+// Thread::TimedSleep
+/*! 	Same as Sleep, but for at most ticks units of simulated time.
+//	The thread is appended to queue (if not NULL), and an alarm is
+//	put in the pending interrupt list of the machine: whichever of
+//	the wake-up by another thread and the alarm comes first ends the
+//	sleep, without any polling. A thread sleeping on a NULL queue
+//	can only be woken up by the alarm.
+//
+//	As for Sleep, interrupts must already be disabled.
+//
+//	\param queue wait queue where the thread blocks, or NULL
+//	\param ticks maximum duration of the sleep (> 0)
+//	\return true if the thread was woken up before the delay expired
+*/
+//----------------------------------------------------------------------
+bool Thread::TimedSleep(IntrusiveList<Thread> *queue, int ticks) {
+	ASSERT(this == g_current_thread);
+	ASSERT(g_machine->interrupt->GetStatus() == INTERRUPTS_OFF);
+	ASSERT(ticks > 0);
+
+	timedOut = false;
+	timedQueue = queue;
+	if (queue != NULL)
+		queue->Append(this);
+	wakeup = g_machine->interrupt->Schedule(ThreadTimeout, (int64_t)this,
+						ticks, ALARM_INT);
+	Sleep();
+
+	// Woken up before the alarm: disarm it
+	if (wakeup != NULL) {
+		g_machine->interrupt->Cancel(wakeup);
+		wakeup = NULL;
+	}
+	timedQueue = NULL;
+	return !timedOut;
+}
+
+//----------------------------------------------------------------------
+// Thread::SetPriority
+/*! 	Set the base priority of the thread. Its effective priority
+//	stays at least the one inherited from the threads waiting for
+//	its locks.
+//
+//	\param newPriority between 0 and NUM_PRIORITIES-1
+*/
+//----------------------------------------------------------------------
+void Thread::SetPriority(int newPriority) {
+	ASSERT(newPriority >= 0 && newPriority < NUM_PRIORITIES);
+	IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+	basePriority = newPriority;
+	UpdatePriority();
+	g_machine->interrupt->SetStatus(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Thread::UpdatePriority
+/*! 	Recompute the effective priority of the thread: the highest of
+//	its base priority and of the priorities of the threads blocked on
+//	the locks it holds. Called when the set of locks held changes,
+//	and when the base priority changes.
+//
+//	Interrupts must be disabled.
+*/
+//----------------------------------------------------------------------
+void Thread::UpdatePriority() {
+	int p = basePriority;
+
+	for (Lock *l = heldLocks->getFirst(); l != NULL; l = heldLocks->getNext(l)) {
+		int w = l->MaxWaiterPriority();
+		if (w > p)
+			p = w;
+	}
+	g_scheduler->ChangePriority(this, p);
+}
+
 //----------------------------------------------------------------------
 // Thread::SaveProcessorState
 /*!	Save the CPU state of a user program on a context switch
@@ -374,9 +615,13 @@ void Thread::SaveProcessorState() {
 #ifdef ETUDIANTS_TP
 	for(int i = 0; i < NUM_INT_REGS; i++)
 		thread_context.int_registers[i] = g_machine->int_registers[i];
-	for(int i = 0; i < NUM_FP_REGS; i++)
-		thread_context.float_registers[i] = g_machine->float_registers[i];
-	thread_context.cc = g_machine->ReadCC();
+	// The FP state only changed if the thread used the FPU during
+	// this time slice (see RestoreFPState)
+	if (g_machine->fpuUsable) {
+		for(int i = 0; i < NUM_FP_REGS; i++)
+			thread_context.float_registers[i] = g_machine->float_registers[i];
+		thread_context.cc = g_machine->ReadCC();
+	}
 #endif
 }
 
@@ -396,11 +641,28 @@ void Thread::RestoreProcessorState() {
 #ifdef ETUDIANTS_TP
   for(int i = 0; i < NUM_INT_REGS; i++)
 		g_machine->int_registers[i] = thread_context.int_registers[i];
+	// The FP state is restored lazily, on the first FP instruction
+	g_machine->fpuUsable = false;
+	g_machine->llBit = false;  // a context switch breaks any LL/SC sequence
+	g_machine->mmu->translationTable = process->addrspace->translationTable;
+#endif
+}
+
+//----------------------------------------------------------------------
+// Thread::RestoreFPState
+/*!	Restore the floating point registers and condition code of the
+//	thread, and enable the FPU until the next context switch. Called
+//	on the first floating point instruction executed by the thread
+//	after it got the CPU, so threads that never use floating point
+//	never pay for saving and restoring the FP registers.
+*/
+//----------------------------------------------------------------------
+void Thread::RestoreFPState() {
+	DEBUG('t', (char *)"Restoring FP state of thread \"%s\"\n", name);
 	for(int i = 0; i < NUM_FP_REGS; i++)
 		g_machine->float_registers[i] = thread_context.float_registers[i];
 	g_machine->WriteCC(thread_context.cc);
-	g_machine->mmu->translationTable = process->addrspace->translationTable;
-#endif
+	g_machine->fpuUsable = true;
 }
 
 //----------------------------------------------------------------------
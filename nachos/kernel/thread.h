@@ -34,6 +34,7 @@ class Thread;
 extern void ThreadPrint(intptr_t arg);
 
 class Semaphore;
+class Lock;
 class Process;
 
 /*! \brief Defines the context of the Nachos simulator
@@ -74,14 +75,26 @@ public:
   //! Start a thread, attaching it to a process (return NoError on success)
   int Start(Process *owner, int32_t func, int arg);
 
+  //! Start a kernel thread, running func(arg) in the kernel on behalf
+  //  of a process (return NoError on success)
+  int StartKernel(Process *owner, VoidFunctionPtr func, int64_t arg);
+
+  //! Start a thread in a process created by Fork, returning from the
+  //  system call of the current thread (return NoError on success)
+  int StartFork(Process *owner);
+
   //! Wait for another thread to finish its execution
   void Join(Thread *Idthread);
 
-  //! Relinquish the CPU if any other thread is runnable.
-  void Yield();  			
+  //! Relinquish the CPU if another thread of at least the same
+  //! priority (or of any priority if toLower) is runnable.
+  void Yield(bool toLower = false);
     
   //! Put the thread to sleep and relinquish the processor 
   void Sleep();  			
+
+  //! Sleep on queue for at most ticks (return false on timeout)
+  bool TimedSleep(IntrusiveList<Thread> *queue, int ticks);
     
   //! Finish the execution of the thread, and prepare its deallocation
   void Finish();  				
@@ -105,6 +118,9 @@ public:
   //! Restore the processor registers.
   void RestoreProcessorState();
 
+  //! Restore the floating point registers, on first use after a switch.
+  void RestoreFPState();
+
   //! Save the state of the Nachos simulator.
   void SaveSimulatorState();	
     
@@ -114,6 +130,19 @@ public:
   char* GetName() { return (name); }
   Process* GetProcessOwner() { return process; }
 
+  //! Effective priority (base priority, possibly raised by inheritance)
+  int GetPriority() { return priority; }
+
+  //! Base priority, as set by SetPriority
+  int GetBasePriority() { return basePriority; }
+
+  //! Set the base priority of the thread
+  void SetPriority(int newPriority);
+
+  //! Recompute the effective priority from the base priority and the
+  //  threads waiting for the locks held by this thread
+  void UpdatePriority();
+
 protected:
   //! Thread name (for debugging)   
   char* name;
@@ -129,11 +158,58 @@ protected:
 
   int local_i_clock;
 
+  //! Kernel function run by a kernel thread, NULL for a user thread
+  VoidFunctionPtr kernelFunc;
+
+  //! Argument of kernelFunc
+  int64_t kernelArg;
+
+  friend void StartKernelThreadExecution(void);
+
 public:
   //! signature to make sure the thread is in the correct state
   ObjectTypeId typeId;
 
+  //! Initial user stack pointer (see AddrSpace::StackAllocate), 0
+  //  for a thread without user stack
   int stackPointer;
+
+  //! Links in the ready list or in the wait queue of a
+  //  synchronization object (a thread is on at most one of them)
+  ListHook<Thread> queueHook;
+
+  //! Links in the list of existing threads (g_alive)
+  ListHook<Thread> aliveHook;
+
+  //! Virtual address of the futex the thread is blocked on, if any
+  int32_t futexAddr;
+
+  //! Channel and key of the page the thread waits for, if any
+  //! (see PageWaitTable)
+  void *waitChannel;
+  int waitKey;
+
+  //! Alarm that ends the current TimedSleep, NULL if none is armed
+  PendingInterrupt *wakeup;
+
+  //! Wait queue of the current TimedSleep (NULL for a plain delay)
+  IntrusiveList<Thread> *timedQueue;
+
+  //! Set when the last TimedSleep ended because the alarm fired
+  bool timedOut;
+
+  //! Effective priority, used by the scheduler (only modified
+  //  through Scheduler::ChangePriority)
+  int priority;
+
+  //! Priority given by the user, not counting inheritance
+  int basePriority;
+
+  //! Lock the thread is blocked on in Lock::Acquire, NULL if none
+  Lock *waitingFor;
+
+  //! Locks held by the thread, from which it may inherit a priority
+  IntrusiveList<Lock> *heldLocks;
 };
 
 #endif // THREAD_H
@@ -24,12 +24,14 @@
 #include "kernel/system.h"
 #include "kernel/thread.h"
 #include "utility/stats.h"
+#include "vm/physMem.h"
 
 //! String definition for debugging messages
 static char *intLevelNames[] = { (char*)"off", (char*)"on"};
 //! String definition for debugging messages
 static char *intTypeNames[] = { (char*)"timer", (char*)"disk", (char*)"console write", 
-			(char*)"console read",(char*)"ACIA receive",(char*)"ACIA send"
+			(char*)"console read",(char*)"ACIA receive",(char*)"ACIA send",
+			(char*)"alarm"
 };
 
 //----------------------------------------------------------------------
@@ -199,6 +201,12 @@ Interrupt::Idle()
 {
     DEBUG('i', (char*)"Machine idling; checking for interrupts.\n");
     g_machine->SetStatus(IDLE_MODE);
+
+    // Use the idle time to zero free pages for the next anonymous
+    // page faults
+    if (g_physical_mem_manager != NULL)
+      g_physical_mem_manager->ZeroFreePages(ZERO_BATCH);
+
     if (CheckIfDue(true)) {		// check for any pending interrupts
     	while (CheckIfDue(false))	// check for any other pending 
 	    ;				// interrupts
@@ -249,9 +257,11 @@ Interrupt::Halt(int errorcode)
 //	\param fromNow is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	\param type is the hardware device that generated the interrupt
+//	\return the scheduled interrupt, which may be given to Cancel
+//		as long as it has not fired
 */
 //----------------------------------------------------------------------
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, int64_t arg, int fromNow, IntType type)
 {
     Time when;
@@ -264,6 +274,26 @@ Interrupt::Schedule(VoidFunctionPtr handler, int64_t arg, int fromNow, IntType t
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
     pending->SortedInsert(toOccur, when);
+    return toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+/*! 	Withdraw an interrupt scheduled by Schedule, which has not fired
+//	yet. Used by the kernel to disarm a timeout when the awaited
+//	event happened first.
+//
+//	\param toCancel is the interrupt returned by Schedule
+*/
+//----------------------------------------------------------------------
+void
+Interrupt::Cancel(PendingInterrupt *toCancel)
+{
+    DEBUG('i', (char *)"Cancelling interrupt handler %s scheduled at time = %llu\n",
+	  intTypeNames[toCancel->type], toCancel->when);
+    bool found = pending->RemoveItem(toCancel);
+    ASSERT(found);
+    delete toCancel;
 }
 
 //----------------------------------------------------------------------
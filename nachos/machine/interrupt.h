@@ -46,7 +46,8 @@ enum IntStatus {INTERRUPTS_OFF, INTERRUPTS_ON};
  In Nachos, we support a hardware timer device, a disk, a console
  display, a keyboard and an ACIA.
 */
-enum IntType {TIMER_INT, DISK_INT, CONSOLE_WRITE_INT, CONSOLE_READ_INT, ACIA_RECEIVE_INT, ACIA_SEND_INT
+enum IntType {TIMER_INT, DISK_INT, CONSOLE_WRITE_INT, CONSOLE_READ_INT, ACIA_RECEIVE_INT, ACIA_SEND_INT,
+	      ALARM_INT
 };
 
 /*! \brief  Defines an interrupt that is scheduled
@@ -86,6 +87,9 @@ public:
 
   IntStatus GetStatus() {return level;}//!< Return whether interrupts
 					//!< are enabled or disabled
+
+  bool InHandler() {return inHandler;}	//!< Return whether an interrupt
+					//!< handler is running
     
   void Idle(); 			//!< The ready queue is empty, roll 
 					//!< simulated time forward until the 
@@ -104,9 +108,12 @@ public:
   // but they need to be public since they are called by the
   // hardware device simulators.
 
-  void Schedule(VoidFunctionPtr handler,//!< Schedule an interrupt to occur
+  PendingInterrupt *Schedule(VoidFunctionPtr handler,//!< Schedule an interrupt to occur
 		  int64_t arg, int when, IntType type);//!< at time ``when''.  This is called
     					//!< by the hardware device simulators.
+
+  void Cancel(PendingInterrupt *toCancel); //!< Withdraw an interrupt that
+					//!< has not fired yet
     
   void OneTick(int nbcy);     // !<Advance simulated time of nbcy cycles
 
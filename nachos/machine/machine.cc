@@ -19,8 +19,8 @@
 static char* exceptionNames[] = { (char*)"no exception", (char*)"syscall", 
 				(char*)"page fault", (char*)"page read only",
 				(char*)"bus error", (char*)"address error", (char*)"overflow",
-				(char*)"illegal instruction" };
-#define EXCEPTION_NUMBER 7 //!< Size of exceptionNames, used for sanity checks
+				(char*)"illegal instruction", (char*)"coprocessor unusable" };
+#define EXCEPTION_NUMBER 8 //!< Size of exceptionNames, used for sanity checks
 
 //----------------------------------------------------------------------
 // CheckEndian
@@ -92,6 +92,9 @@ Machine::Machine(bool debug)
       int_registers[i] = 0;
     for (i = 0; i < NUM_FP_REGS; i++)
       float_registers[i] = 0;
+    fpuUsable = false;
+    llBit = false;
+    llAddr = 0;
 
     // Allocate the main memory of the machine and fills it up with zeroes
     int memSize = g_cfg->NumPhysPages * g_cfg->PageSize;
@@ -157,6 +160,7 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     // Call of the exception handler
     int_registers[BADVADDR_REG] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    llBit = false;			// a trap breaks any LL/SC sequence
     this->status=SYSTEM_MODE;
     ExceptionHandler(which,badVAddr);	// call the exception handler
     this->status=USER_MODE;              // interrupts are enabled at this point
@@ -43,6 +43,8 @@ enum ExceptionType { NO_EXCEPTION,           //!< Everything ok!
 					     space */
 		     OVERFLOW_EXCEPTION,     //!< Integer overflow in add or sub.
 		     ILLEGALINSTR_EXCEPTION, //!< Unimplemented or reserved instr.
+		     COPUNUSABLE_EXCEPTION,  /*!< Floating point instruction
+					      while the FPU is disabled */
 		     
 		     NUM_EXCEPTION_TYPES
 };
@@ -174,6 +176,17 @@ class Machine {
   int8_t cc;                     /*!< Condition code. Note that
 				 since only MIPS I FP instrs are implemented */
 
+  bool fpuUsable;                /*!< When false, any floating point
+				   instruction raises a
+				   COPUNUSABLE_EXCEPTION (the float
+				   registers and cc do not belong to
+				   the running thread) */
+
+  bool llBit;                    /*!< Set by LL, cleared by any trap or
+				   context switch: SC only succeeds
+				   while it is set */
+  int32_t llAddr;                //!< Virtual address of the last LL
+
   int8_t *mainMemory;		/*!< Physical memory to store user program,
 				  code and data, while executing
 				*/
@@ -219,6 +219,13 @@ Machine::OneInstruction(Instruction *instr)
     printf(" Time total %" PRIu64 "\n",g_stats->getTotalTicks());
   }
 
+  // Floating point instructions (and the FP condition code they use)
+  // trap until the kernel has loaded the FP state of the running thread
+  if (!fpuUsable && instr->opCode >= OP_LWC1 && instr->opCode <= OP_CTC1) {
+    RaiseException(COPUNUSABLE_EXCEPTION, 0);
+    return 0;
+  }
+
   // Compute next Program Counter (PC), but don't install in 
   // case there's an error or branch.
   int pcAfter = int_registers[NEXTPC_REG] + 4;
@@ -388,6 +395,20 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadValue = value;
 	break;
     	
+      case OP_LL:
+	tmp = int_registers[(int)instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(ADDRESSERROR_EXCEPTION, tmp);
+	    return 0;
+	}
+	if (!mmu->ReadMem(tmp, 4, &value,false))
+	  return 0;
+	llBit = true;
+	llAddr = tmp;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	break;
+
       case OP_LWL:	  
 	tmp = int_registers[(int)instr->rs] + instr->extra;
 
@@ -593,6 +614,26 @@ Machine::OneInstruction(Instruction *instr)
 	    return 0;
 	break;
 	
+      case OP_SC:
+	// The store only takes place if no trap or context switch
+	// occurred since the matching LL. rt receives 1 on success,
+	// 0 on failure.
+	tmp = int_registers[(int)instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(ADDRESSERROR_EXCEPTION, tmp);
+	    return 0;
+	}
+	if (llBit && llAddr == tmp) {
+	  if (!mmu->WriteMem((unsigned) tmp, 4,
+			     int_registers[(int)instr->rt]))
+	    return 0;
+	  int_registers[(int)instr->rt] = 1;
+	}
+	else
+	  int_registers[(int)instr->rt] = 0;
+	llBit = false;
+	break;
+
       case OP_SWL:	  
 	tmp = int_registers[(int)instr->rs] + instr->extra;
 
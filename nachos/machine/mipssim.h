@@ -163,10 +163,14 @@
 #define OP_MTC1         134
 #define OP_CTC1         135
 
-#define OP_UNIMP	136
-#define OP_RES		137
+// Load linked / store conditional (MIPS II)
+#define OP_LL           136
+#define OP_SC           137
 
-#define MaxOpcode	137
+#define OP_UNIMP	138
+#define OP_RES		139
+
+#define MaxOpcode	139
 
 /*
  * Miscellaneous definitions:
@@ -214,9 +218,9 @@ static OpInfo opTable[] = {
     {OP_LBU, IFMT}, {OP_LHU, IFMT}, {OP_LWR, IFMT}, {OP_RES, IFMT},
     {OP_SB, IFMT}, {OP_SH, IFMT}, {OP_SWL, IFMT}, {OP_SW, IFMT},
     {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_SWR, IFMT}, {OP_RES, IFMT},
-    {OP_UNIMP, IFMT}, {OP_LWC1, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_LL, IFMT}, {OP_LWC1, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
     {OP_RES, IFMT}, {OP_LDC1, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
-    {OP_UNIMP, IFMT}, {OP_SWC1, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_SC, IFMT}, {OP_SWC1, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
     {OP_RES, IFMT}, {OP_SDC1, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}
 };
 
@@ -436,6 +440,8 @@ static struct OpString opStrings[] = {
         {(char*)"OP_CFC1 r%d,f%d", {RT, FS, NONE}},
 	{(char*)"OP_MTC1 r%d,f%d", {RT, FS, NONE}},
         {(char*)"OP_CTC1 r%d,f%d", {RT, FS, NONE}},
+	{(char*)"LL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{(char*)"SC r%d,%d(r%d)", {RT, EXTRA, RS}},
 	{(char*)"Unimplemented", {NONE, NONE, NONE}},
 	{(char*)"Reserved", {NONE, NONE, NONE}}
       };
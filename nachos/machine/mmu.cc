@@ -33,6 +33,7 @@
 //----------------------------------------------------------------------
 MMU::MMU() {
   translationTable = NULL;
+  faultOnWrite = false;
 }
 
 //----------------------------------------------------------------------
@@ -223,11 +224,14 @@ MMU::Translate(int virtAddr, int* physAddr, int size, bool writing)
     return ADDRESSERROR_EXCEPTION;
   }
 
-  // Check access rights
+  // Check access rights. The kernel may grant a write access to a
+  // read-only page (copy-on-write)
   if (writing && !translationTable->getBitWriteAllowed(vpn)) {
     DEBUG('h', (char *)"write access on read-only virtual page # %d !\n",
 	  vpn);
-    return READONLY_EXCEPTION;
+    g_machine->RaiseException(READONLY_EXCEPTION, virtAddr);
+    if (!translationTable->getBitWriteAllowed(vpn))
+      return READONLY_EXCEPTION;
   }
 
   // If the page is not yet in main memory, run the page fault manager
@@ -238,6 +242,7 @@ MMU::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	  vpn);
 
     // call the page fault manager
+    faultOnWrite = writing;
     g_machine->RaiseException(PAGEFAULT_EXCEPTION, virtAddr);
 
     if (!translationTable->getBitValid(vpn)) {
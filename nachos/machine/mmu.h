@@ -44,6 +44,10 @@ public:
   // to physical addresses (relative to the beginning of "mainMemory")
   // is controlled by a traditional linear page table
   TranslationTable *translationTable; //!< Pointer to the translation table
+
+  //! true if the last page fault was raised by a write access (as
+  //! reported by the cause register of a real MMU)
+  bool faultOnWrite;
 };
 
 #endif // MMU_H
@@ -0,0 +1,80 @@
+#include "userlib/syscall.h"
+#include "userlib/libnachos.h"
+
+#define NB_WORDS 256 /* two pages of 128 bytes and more */
+
+int data[4] = {1, 2, 3, 4}; // initialized data, read from the executable
+int words[NB_WORDS];        // bss, written before the fork
+
+int errors;
+
+void check(int cond, char *what) {
+  if (!cond) {
+    n_printf("forktest: %s failed\n", what);
+    errors++;
+  }
+}
+
+int main() {
+  ThreadId child;
+  OpenFileId f;
+  int local = 42; // on the stack, shared copy-on-write too
+  int i;
+
+  for (i = 0; i < NB_WORDS; i++)
+    words[i] = i;
+
+  child = Fork();
+  if (child < 0) {
+    PError("forktest: Fork");
+    Exit(1);
+  }
+
+  if (child == 0) {
+    // Child: Fork returned 0, and the memory is the parent's one at
+    // the time of the fork, whatever the parent wrote since
+    for (i = 0; i < NB_WORDS; i++)
+      check(words[i] == i, "child sees the words of the parent");
+    check(data[0] == 1 && data[3] == 4, "child sees the data of the parent");
+    check(local == 42, "child sees the stack of the parent");
+
+    // Writes of the child stay private
+    for (i = 0; i < NB_WORDS; i++)
+      words[i] = -i;
+    data[0] = -1;
+    local = -42;
+    Yield();
+    for (i = 0; i < NB_WORDS; i++)
+      check(words[i] == -i, "child keeps its own words");
+    check(data[0] == -1 && local == -42, "child keeps its own data");
+    n_printf("forktest: child done, %d error(s)\n", errors);
+    Exit(errors);
+  }
+
+  // Parent: write while the child runs, then check the child's
+  // writes did not show up here
+  for (i = 0; i < NB_WORDS; i++)
+    words[i] = 2 * i;
+  data[3] = 40;
+  Join(child);
+  for (i = 0; i < NB_WORDS; i++)
+    check(words[i] == 2 * i, "parent keeps its own words");
+  check(data[0] == 1 && data[3] == 40, "parent keeps its own data");
+  check(local == 42, "parent keeps its own stack");
+
+  // A process with mapped files cannot be forked
+  if ((f = Open("/numbers.dat")) == -1 || Mmap(f, 4) == -1) {
+    n_printf("forktest: could not map /numbers.dat\n");
+    errors++;
+  } else {
+    child = Fork();
+    if (child == 0)
+      Exit(1);
+    check(child < 0, "Fork with a mapped file is refused");
+    PError("forktest: Fork with a mapped file (expected error)");
+  }
+
+  n_printf("forktest: parent done, %d error(s)\n", errors);
+  Exit(errors);
+  return 0;
+}
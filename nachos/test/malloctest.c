@@ -0,0 +1,92 @@
+#include "userlib/syscall.h"
+#include "userlib/libnachos.h"
+
+#define PAGE 128            /* PageSize in nachos.cfg */
+#define NB_BLOCKS 100
+#define LARGE 3000          /* more than the biggest size class */
+
+int errors;
+
+void check(int cond, char *what) {
+  if (!cond) {
+    n_printf("malloctest: %s failed\n", what);
+    errors++;
+  }
+}
+
+int *blocks[NB_BLOCKS];
+
+int main() {
+  char *base, *p, *q, *big, *big2;
+  int i, ok;
+
+  // Sbrk by hand: growing, shrinking and growing again gives back
+  // zero-filled pages
+  base = (char *)Sbrk(0);
+  check(base != (char *)-1, "Sbrk(0)");
+  check((char *)Sbrk(3 * PAGE) == base, "Sbrk returns the previous break");
+  check((char *)Sbrk(0) == base + 3 * PAGE, "Sbrk moves the break");
+  n_memset(base, 'x', 3 * PAGE);
+  check((char *)Sbrk(-2 * PAGE) == base + 3 * PAGE, "negative Sbrk");
+  check((char *)Sbrk(0) == base + PAGE, "negative Sbrk moves the break");
+  Sbrk(2 * PAGE);
+  ok = base[0] == 'x' && base[PAGE - 1] == 'x';
+  for (i = PAGE; i < 3 * PAGE; i++)
+    if (base[i] != 0)
+      ok = 0;
+  check(ok, "the pages released by a negative Sbrk come back zeroed");
+  Sbrk(-3 * PAGE);
+
+  // Sbrk fails below the start of the heap or past its end, and the
+  // break does not move then
+  check(Sbrk(-1) == (void *)-1, "Sbrk below the heap fails");
+  check(Sbrk(0x10000000) == (void *)-1, "Sbrk past the heap fails");
+  check((char *)Sbrk(0) == base, "a failed Sbrk leaves the break");
+
+  // A freed block is reused by the next allocation of its class
+  p = (char *)n_malloc(20);
+  n_free(p);
+  q = (char *)n_malloc(24);
+  check(p == q, "a freed block is reused in its class");
+  n_free(q);
+
+  // Blocks do not overlap
+  for (i = 0; i < NB_BLOCKS; i++) {
+    blocks[i] = (int *)n_malloc(10 * sizeof(int));
+    check(blocks[i] != 0, "n_malloc");
+    n_memset(blocks[i], i, 10 * sizeof(int));
+  }
+  ok = 1;
+  for (i = 0; i < NB_BLOCKS; i++)
+    if (blocks[i][0] != blocks[i][9] || (blocks[i][0] & 0xff) != i)
+      ok = 0;
+  check(ok, "the blocks do not overlap");
+  for (i = 0; i < NB_BLOCKS; i++)
+    n_free(blocks[i]);
+
+  // A large block freed at the end of the heap shrinks it
+  p = (char *)Sbrk(0);
+  big = (char *)n_malloc(LARGE);
+  check(big != 0 && (char *)Sbrk(0) > p, "a large block grows the heap");
+  n_free(big);
+  check((char *)Sbrk(0) == p, "freeing the last large block shrinks the heap");
+
+  // A large block freed elsewhere is reused by a close enough size
+  big = (char *)n_malloc(LARGE);
+  big2 = (char *)n_malloc(LARGE);
+  n_free(big);
+  q = (char *)n_malloc(LARGE - 100);
+  check(q == big, "a freed large block is reused");
+  n_free(big2);
+  n_free(q);
+  check((char *)Sbrk(0) == p, "freeing the large blocks shrinks the heap");
+
+  // Allocations the heap cannot hold fail
+  check(n_malloc(0x7fff0001) == 0, "n_malloc of a huge size fails");
+  check(n_malloc(0x10000000) == 0, "n_malloc past the heap fails");
+  check((char *)Sbrk(0) == p, "a failed n_malloc leaves the break");
+
+  n_printf("malloctest: %d error(s)\n", errors);
+  Exit(errors);
+  return 0;
+}
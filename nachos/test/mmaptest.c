@@ -0,0 +1,77 @@
+#include "userlib/syscall.h"
+#include "userlib/libnachos.h"
+
+#define PAGE 128            /* PageSize in nachos.cfg */
+#define NB_PAGES 4
+#define SIZE (NB_PAGES * PAGE)
+
+int errors;
+
+void check(int cond, char *what) {
+  if (!cond) {
+    n_printf("mmaptest: %s failed\n", what);
+    errors++;
+  }
+}
+
+char buff[SIZE];
+
+int main() {
+  OpenFileId f;
+  char *map;
+  int i, ok;
+
+  // A file of NB_PAGES pages of 'a'
+  n_memset(buff, 'a', SIZE);
+  if (Create("/mmaptest.dat", SIZE) == -1 || (f = Open("/mmaptest.dat")) == -1
+      || Write(buff, SIZE, f) != SIZE) {
+    PError("mmaptest: create /mmaptest.dat");
+    Exit(1);
+  }
+
+  if ((map = (char *)Mmap(f, SIZE)) == (char *)-1) {
+    PError("mmaptest: Mmap");
+    Exit(1);
+  }
+
+  // Only the dirty pages are written back, once
+  check(map[0] == 'a' && map[SIZE - 1] == 'a', "the mapping shows the file");
+  check(Msync(map) == 0, "Msync of clean pages writes nothing");
+  map[0] = 'b';
+  map[2 * PAGE + 5] = 'c';
+  check(Msync(map + PAGE) == 2, "Msync writes the two dirty pages");
+  check(Msync(map) == 0, "Msync after Msync writes nothing");
+  Seek(0, f);
+  check(Read(buff, SIZE, f) == SIZE, "Read after Msync");
+  check(buff[0] == 'b' && buff[2 * PAGE + 5] == 'c' && buff[1] == 'a',
+	"the file holds the synced pages");
+
+  // Bad addresses are refused
+  check(Msync((void *)buff) == -1, "Msync outside of a mapping");
+  check(Msync(map + SIZE) == -1, "Msync past the end of the mapping");
+  check(Munmap(map + PAGE) == -1, "Munmap inside of a mapping");
+  check(Munmap((void *)buff) == -1, "Munmap outside of a mapping");
+
+  // Munmap writes the dirty pages back, then the mapping is gone
+  map[3 * PAGE] = 'd';
+  check(Munmap(map) == 0, "Munmap");
+  Seek(0, f);
+  check(Read(buff, SIZE, f) == SIZE, "Read after Munmap");
+  check(buff[3 * PAGE] == 'd', "Munmap wrote the dirty page back");
+  ok = 1;
+  for (i = 0; i < SIZE; i++)
+    if (i != 0 && i != 2 * PAGE + 5 && i != 3 * PAGE && buff[i] != 'a')
+      ok = 0;
+  check(ok, "the clean bytes are unchanged");
+  check(Munmap(map) == -1, "Munmap twice");
+  check(Msync(map) == -1, "Msync after Munmap");
+  Close(f);
+
+  n_printf("mmaptest: %d error(s), now touching the unmapped area: "
+	   "the access fault below is expected\n", errors);
+  map[0] = 'e';
+
+  n_printf("mmaptest: the unmapped area is still accessible\n");
+  Exit(1);
+  return 0;
+}
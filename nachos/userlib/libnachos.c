@@ -82,6 +82,233 @@ ThreadId threadCreate2(char *debug_name, VoidFunctionPtr func, int argc, char *a
 }
 #endif
 
+//----------------------------------------------------------------------
+// n_mutex_init()
+/*!	Initialize a user-level mutex, initially free.
+//
+//	\param m is the mutex to initialize
+*/
+//----------------------------------------------------------------------
+void n_mutex_init(n_mutex_t *m)
+{
+  m->state = 0;
+}
+
+//----------------------------------------------------------------------
+// n_mutex_lock()
+/*!	Acquire a user-level mutex. When the mutex is free, this costs
+//      a single LL/SC sequence and no system call. Otherwise the mutex
+//      is marked as contended and the thread blocks in the kernel
+//      until the owner releases it.
+//
+//	\param m is the mutex to acquire
+*/
+//----------------------------------------------------------------------
+void n_mutex_lock(n_mutex_t *m)
+{
+  int c = AtomicCas(&m->state, 0, 1);
+  if (c == 0)
+    return;		// Fast path: the mutex was free
+  if (c != 2)
+    c = AtomicSwap(&m->state, 2);
+  while (c != 0) {
+    FutexWait(&m->state, 2);
+    c = AtomicSwap(&m->state, 2);
+  }
+}
+
+//----------------------------------------------------------------------
+// n_mutex_unlock()
+/*!	Release a user-level mutex, and wake up one waiter if the mutex
+//      was contended.
+//
+//	\param m is the mutex to release
+*/
+//----------------------------------------------------------------------
+void n_mutex_unlock(n_mutex_t *m)
+{
+  if (AtomicSwap(&m->state, 0) == 2)
+    FutexWake(&m->state, 1);
+}
+
+//----------------------------------------------------------------------
+// n_cond_init()
+/*!	Initialize a user-level condition variable.
+//
+//	\param c is the condition variable to initialize
+*/
+//----------------------------------------------------------------------
+void n_cond_init(n_cond_t *c)
+{
+  c->seq = 0;
+}
+
+//----------------------------------------------------------------------
+// n_cond_wait()
+/*!	Release m, wait until the condition is signalled, then
+//      re-acquire m. The sequence number is sampled before releasing
+//      the mutex, so a signal sent in between is never lost: the
+//      FutexWait then returns at once.
+//
+//	\param c is the condition variable to wait on
+//	\param m is the mutex protecting the condition, held by the caller
+*/
+//----------------------------------------------------------------------
+void n_cond_wait(n_cond_t *c, n_mutex_t *m)
+{
+  int seq = c->seq;
+  n_mutex_unlock(m);
+  FutexWait(&c->seq, seq);
+  // Other threads may have been woken up at the same time: take the
+  // mutex in contended state so that its release wakes them up
+  while (AtomicSwap(&m->state, 2) != 0)
+    FutexWait(&m->state, 2);
+}
+
+//----------------------------------------------------------------------
+// n_cond_signal()
+/*!	Wake up one thread waiting on a condition variable, if any.
+//
+//	\param c is the condition variable to signal
+*/
+//----------------------------------------------------------------------
+void n_cond_signal(n_cond_t *c)
+{
+  int seq;
+  do {
+    seq = c->seq;
+  } while (AtomicCas(&c->seq, seq, seq + 1) != seq);
+  FutexWake(&c->seq, 1);
+}
+
+//----------------------------------------------------------------------
+// n_cond_broadcast()
+/*!	Wake up all the threads waiting on a condition variable.
+//
+//	\param c is the condition variable to signal
+*/
+//----------------------------------------------------------------------
+void n_cond_broadcast(n_cond_t *c)
+{
+  int seq;
+  do {
+    seq = c->seq;
+  } while (AtomicCas(&c->seq, seq, seq + 1) != seq);
+  FutexWake(&c->seq, 0x7fffffff);
+}
+
+//----------------------------------------------------------------------
+// n_ring_init()
+/*!	Get the system call ring of the process, mapping it on first
+//      call.
+//
+//	\return the ring, NULL on error
+*/
+//----------------------------------------------------------------------
+RingPage *n_ring_init(void)
+{
+  return RingSetup();
+}
+
+//----------------------------------------------------------------------
+// n_ring_prep()
+/*!	Queue an operation in the submission queue of a ring. It is only
+//      executed by the next n_ring_submit.
+//
+//	\param r is the ring
+//	\param opcode is the operation (RING_OP_xxx)
+//	\param a0, a1, a2 are the arguments of the operation
+//	\param user_data is returned with the result of the operation
+//	\return 0, or -1 if the submission queue is full
+*/
+//----------------------------------------------------------------------
+static int n_ring_prep(RingPage *r, int opcode, int a0, int a1, int a2,
+		       int user_data)
+{
+  // sq_head is updated by the kernel behind our back
+  volatile RingPage *vr = r;
+  int tail = vr->sq_tail;
+  volatile RingSqe *sqe;
+
+  if (tail - vr->sq_head >= RING_ENTRIES)
+    return -1;
+  sqe = &vr->sq[tail % RING_ENTRIES];
+  sqe->opcode = opcode;
+  sqe->arg[0] = a0;
+  sqe->arg[1] = a1;
+  sqe->arg[2] = a2;
+  sqe->user_data = user_data;
+  vr->sq_tail = tail + 1;
+  return 0;
+}
+
+//----------------------------------------------------------------------
+// n_ring_read(), n_ring_write(), n_ring_p(), n_ring_v()
+/*!	Queue a Read, Write, P or V operation in a ring. The arguments
+//      are those of the corresponding system call.
+//
+//	\return 0, or -1 if the submission queue is full
+*/
+//----------------------------------------------------------------------
+int n_ring_read(RingPage *r, OpenFileId f, char *buffer, int size,
+		int user_data)
+{
+  return n_ring_prep(r, RING_OP_READ, (int)buffer, size, f, user_data);
+}
+
+int n_ring_write(RingPage *r, OpenFileId f, char *buffer, int size,
+		 int user_data)
+{
+  return n_ring_prep(r, RING_OP_WRITE, (int)buffer, size, f, user_data);
+}
+
+int n_ring_p(RingPage *r, SemId sema, int user_data)
+{
+  return n_ring_prep(r, RING_OP_P, sema, 0, 0, user_data);
+}
+
+int n_ring_v(RingPage *r, SemId sema, int user_data)
+{
+  return n_ring_prep(r, RING_OP_V, sema, 0, 0, user_data);
+}
+
+//----------------------------------------------------------------------
+// n_ring_submit()
+/*!	Execute all the operations queued in a ring, with a single
+//      system call.
+//
+//	\param r is the ring
+//	\return the number of operations executed
+*/
+//----------------------------------------------------------------------
+int n_ring_submit(RingPage *r)
+{
+  (void)r;
+  return RingEnter(0);
+}
+
+//----------------------------------------------------------------------
+// n_ring_reap()
+/*!	Get the next completion of a ring, without entering the kernel.
+//
+//	\param r is the ring
+//	\param cqe is where the completion is copied
+//	\return 1 if a completion was copied, 0 if there is none
+*/
+//----------------------------------------------------------------------
+int n_ring_reap(RingPage *r, RingCqe *cqe)
+{
+  volatile RingPage *vr = r;
+  int head = vr->cq_head;
+
+  if (head == vr->cq_tail)
+    return 0;
+  cqe->user_data = vr->cq[head % RING_ENTRIES].user_data;
+  cqe->result = vr->cq[head % RING_ENTRIES].result;
+  vr->cq_head = head + 1;
+  return 1;
+}
+
 //----------------------------------------------------------------------
 // n_strcmp()
 /*!	String comparison
@@ -337,6 +564,167 @@ void *n_memset(void *s, int c, size_t n)
   return (void *)c1;
 }
 
+//! Size of the blocks of the first size class (header included)
+#define MALLOC_MIN_BLOCK 16
+
+//! Number of size classes: blocks of 16, 32, ..., 2048 bytes
+#define MALLOC_CLASSES 8
+
+//! Bytes taken from the heap when an arena has no block left
+#define MALLOC_CHUNK 4096
+
+//! Header of a block, right before the address returned by n_malloc
+typedef struct {
+  int cls;    // size class, MALLOC_CLASSES for a large block
+  int size;   // size of the block in bytes, header included
+} n_block;
+
+//! Link of a free block to the next one, stored after its header
+#define NEXT_FREE(b) (*(n_block **)((b) + 1))
+
+//! Arena of a size class
+static struct {
+  char *cur;        // part of the last chunk never allocated yet
+  char *end;
+  n_block *free;    // blocks freed, to be allocated first
+} arenas[MALLOC_CLASSES];
+
+//! Large blocks freed, which are not at the end of the heap
+static n_block *large_free;
+
+//! Protects the arenas (a zeroed mutex is free)
+static n_mutex_t malloc_lock;
+
+//----------------------------------------------------------------------
+// n_arena_alloc()
+/*!	Take a block from the arena of a size class: a freed block if
+//      any, otherwise the next block of the current chunk, getting a
+//      new chunk from the heap when it is exhausted. Blocks are only
+//      touched when they are allocated, so the pages of a chunk only
+//      get physical memory when actually used.
+//
+//	\param cls is the size class
+//	\return the block, 0 if the heap cannot grow
+*/
+//----------------------------------------------------------------------
+static n_block *n_arena_alloc(int cls)
+{
+  int bsize = MALLOC_MIN_BLOCK << cls;
+  n_block *b = arenas[cls].free;
+
+  if (b != 0) {
+    arenas[cls].free = NEXT_FREE(b);
+    return b;
+  }
+  // Chunks are a multiple of all the block sizes: nothing is lost
+  if (arenas[cls].cur == arenas[cls].end) {
+    char *chunk = (char *)Sbrk(MALLOC_CHUNK);
+    if (chunk == (char *)-1)
+      return 0;
+    arenas[cls].cur = chunk;
+    arenas[cls].end = chunk + MALLOC_CHUNK;
+  }
+  b = (n_block *)arenas[cls].cur;
+  arenas[cls].cur += bsize;
+  b->cls = cls;
+  b->size = bsize;
+  return b;
+}
+
+//----------------------------------------------------------------------
+// n_large_alloc()
+/*!	Get a large block: the first freed one that is big enough but
+//      less than twice too big, otherwise a new one at the end of the
+//      heap.
+//
+//	\param size is the size of the block, header included
+//	\return the block, 0 if the heap cannot grow
+*/
+//----------------------------------------------------------------------
+static n_block *n_large_alloc(int size)
+{
+  n_block **pb;
+  n_block *b;
+
+  for (pb = &large_free; *pb != 0; pb = &NEXT_FREE(*pb)) {
+    b = *pb;
+    if (b->size >= size && b->size / 2 < size) {
+      *pb = NEXT_FREE(b);
+      return b;
+    }
+  }
+  b = (n_block *)Sbrk(size);
+  if (b == (n_block *)-1)
+    return 0;
+  b->cls = MALLOC_CLASSES;
+  b->size = size;
+  return b;
+}
+
+//----------------------------------------------------------------------
+// n_malloc()
+/*!	Allocate a memory block. Blocks up to 2048 bytes (header
+//      included) come from the arena of their size class, larger ones
+//      from the heap. Blocks are aligned on 8 bytes.
+//
+//	\param size is the number of bytes wanted
+//	\return the address of the block (not initialized), 0 on error
+*/
+//----------------------------------------------------------------------
+void *n_malloc(size_t size)
+{
+  int total, cls;
+  n_block *b;
+
+  if (size > 0x7fff0000)
+    return 0;
+  total = (size + sizeof(n_block) + 7) & ~7;
+  for (cls = 0; cls < MALLOC_CLASSES; cls++)
+    if ((MALLOC_MIN_BLOCK << cls) >= total)
+      break;
+
+  n_mutex_lock(&malloc_lock);
+  if (cls < MALLOC_CLASSES)
+    b = n_arena_alloc(cls);
+  else
+    b = n_large_alloc(total);
+  n_mutex_unlock(&malloc_lock);
+
+  if (b == 0)
+    return 0;
+  return (void *)(b + 1);
+}
+
+//----------------------------------------------------------------------
+// n_free()
+/*!	Free a memory block. Small blocks go back to their arena. A
+//      large block at the end of the heap is given back to the kernel
+//      (Sbrk) with its pages; other large blocks are kept for reuse.
+//
+//	\param ptr is the address returned by n_malloc, or 0
+*/
+//----------------------------------------------------------------------
+void n_free(void *ptr)
+{
+  n_block *b;
+
+  if (ptr == 0)
+    return;
+  b = (n_block *)ptr - 1;
+
+  n_mutex_lock(&malloc_lock);
+  if (b->cls < MALLOC_CLASSES) {
+    NEXT_FREE(b) = arenas[b->cls].free;
+    arenas[b->cls].free = b;
+  } else if ((char *)b + b->size == (char *)Sbrk(0))
+    Sbrk(-b->size);
+  else {
+    NEXT_FREE(b) = large_free;
+    large_free = b;
+  }
+  n_mutex_unlock(&malloc_lock);
+}
+
 //----------------------------------------------------------------------
 // n_dumpmem()
 /*!	Dumps on the string the n first bytes of a memory area
@@ -38,6 +38,42 @@ ThreadId threadCreate2(char *debug_name, VoidFunctionPtr func, int argc, char *a
 // ----------------------------
 ThreadId threadCreate(char *debug_name, VoidNoArgFunctionPtr func);
 
+// User-level synchronization :
+// ----------------------------
+// Built on AtomicCas/AtomicSwap and the futex system calls: the kernel
+// is only entered when a thread has to block or to be woken up.
+
+// Mutex: 0 = free, 1 = locked, 2 = locked with (possible) waiters
+typedef struct { int state; } n_mutex_t;
+
+// Condition variable: sequence number bumped by each signal
+typedef struct { int seq; } n_cond_t;
+
+void n_mutex_init(n_mutex_t *m);
+void n_mutex_lock(n_mutex_t *m);
+void n_mutex_unlock(n_mutex_t *m);
+
+void n_cond_init(n_cond_t *c);
+void n_cond_wait(n_cond_t *c, n_mutex_t *m);
+void n_cond_signal(n_cond_t *c);
+void n_cond_broadcast(n_cond_t *c);
+
+// Batched system calls :
+// ----------------------
+// Operations are queued in the system call ring of the process, then
+// executed by a single trap (n_ring_submit). Each n_ring_xxx queuing
+// function returns -1 when the submission queue is full.
+
+RingPage *n_ring_init(void);
+int n_ring_read(RingPage *r, OpenFileId f, char *buffer, int size, int user_data);
+int n_ring_write(RingPage *r, OpenFileId f, char *buffer, int size, int user_data);
+int n_ring_p(RingPage *r, SemId sema, int user_data);
+int n_ring_v(RingPage *r, SemId sema, int user_data);
+int n_ring_submit(RingPage *r);
+
+// Get the next completion in *cqe: returns 1, or 0 if there is none
+int n_ring_reap(RingPage *r, RingCqe *cqe);
+
 // Input/Output operations :
 // ------------------------------------
 
@@ -87,3 +123,14 @@ void *n_memcpy(void *s1, const void *s2, size_t n);
 
 // Set the first n bytes in a memory area to a specified value.
 void *n_memset(void *s, int c, size_t n);
+
+// Dynamic memory allocation :
+// ---------------------------
+// Small blocks come from one arena per size class, carved out of the
+// heap (Sbrk) on demand; large blocks are taken from the heap directly.
+
+// Allocate a block of size bytes (not initialized). Returns 0 on error.
+void *n_malloc(size_t size);
+
+// Free a block returned by n_malloc (0 is ignored).
+void n_free(void *ptr);
@@ -321,3 +321,193 @@ Mmap:	addiu $2,$0,SC_MMAP
 	syscall
 	j	$31
 	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:	addiu $2,$0,SC_MUNMAP
+	syscall
+	j	$31
+	.end Munmap
+
+	.globl Msync
+	.ent	Msync
+Msync:	addiu $2,$0,SC_MSYNC
+	syscall
+	j	$31
+	.end Msync
+
+	.globl Sbrk
+	.ent	Sbrk
+Sbrk:	addiu $2,$0,SC_SBRK
+	syscall
+	j	$31
+	.end Sbrk
+
+	.globl FutexWait
+	.ent	FutexWait
+FutexWait:
+	addiu $2,$0,SC_FUTEX_WAIT
+	syscall
+	j	$31
+	.end FutexWait
+
+	.globl FutexWake
+	.ent	FutexWake
+FutexWake:
+	addiu $2,$0,SC_FUTEX_WAKE
+	syscall
+	j	$31
+	.end FutexWake
+
+	.globl RWLockCreate
+	.ent	RWLockCreate
+RWLockCreate:
+	addiu $2,$0,SC_RWLOCK_CREATE
+	syscall
+	j	$31
+	.end RWLockCreate
+
+	.globl RWLockDestroy
+	.ent	RWLockDestroy
+RWLockDestroy:
+	addiu $2,$0,SC_RWLOCK_DESTROY
+	syscall
+	j	$31
+	.end RWLockDestroy
+
+	.globl RWLockRead
+	.ent	RWLockRead
+RWLockRead:
+	addiu $2,$0,SC_RWLOCK_READ
+	syscall
+	j	$31
+	.end RWLockRead
+
+	.globl RWLockWrite
+	.ent	RWLockWrite
+RWLockWrite:
+	addiu $2,$0,SC_RWLOCK_WRITE
+	syscall
+	j	$31
+	.end RWLockWrite
+
+	.globl RWLockRelease
+	.ent	RWLockRelease
+RWLockRelease:
+	addiu $2,$0,SC_RWLOCK_RELEASE
+	syscall
+	j	$31
+	.end RWLockRelease
+
+	.globl BarrierCreate
+	.ent	BarrierCreate
+BarrierCreate:
+	addiu $2,$0,SC_BARRIER_CREATE
+	syscall
+	j	$31
+	.end BarrierCreate
+
+	.globl BarrierDestroy
+	.ent	BarrierDestroy
+BarrierDestroy:
+	addiu $2,$0,SC_BARRIER_DESTROY
+	syscall
+	j	$31
+	.end BarrierDestroy
+
+	.globl BarrierWait
+	.ent	BarrierWait
+BarrierWait:
+	addiu $2,$0,SC_BARRIER_WAIT
+	syscall
+	j	$31
+	.end BarrierWait
+
+	.globl Sleep
+	.ent	Sleep
+Sleep:
+	addiu $2,$0,SC_SLEEP
+	syscall
+	j	$31
+	.end Sleep
+
+	.globl PTimed
+	.ent	PTimed
+PTimed:
+	addiu $2,$0,SC_P_TIMED
+	syscall
+	j	$31
+	.end PTimed
+
+	.globl RingSetup
+	.ent	RingSetup
+RingSetup:
+	addiu $2,$0,SC_RING_SETUP
+	syscall
+	j	$31
+	.end RingSetup
+
+	.globl RingEnter
+	.ent	RingEnter
+RingEnter:
+	addiu $2,$0,SC_RING_ENTER
+	syscall
+	j	$31
+	.end RingEnter
+
+	.globl SetPriority
+	.ent	SetPriority
+SetPriority:
+	addiu $2,$0,SC_SET_PRIORITY
+	syscall
+	j	$31
+	.end SetPriority
+
+	.globl Fork
+	.ent	Fork
+Fork:
+	addiu $2,$0,SC_FORK
+	syscall
+	j	$31
+	.end Fork
+
+/* -------------------------------------------------------------
+ * Atomic operations:
+ *	LL/SC loops, retried until the store conditional succeeds.
+ *	The simulator applies load delays to LL as to LW, hence the
+ *	nop after each LL.
+ * -------------------------------------------------------------
+ */
+
+	.set noreorder
+	.set mips2
+
+	.globl AtomicCas
+	.ent	AtomicCas
+AtomicCas:
+	ll	$2,0($4)
+	nop
+	bne	$2,$5,1f
+	move	$8,$6
+	sc	$8,0($4)
+	beq	$8,$0,AtomicCas
+	nop
+1:	j	$31
+	nop
+	.end AtomicCas
+
+	.globl AtomicSwap
+	.ent	AtomicSwap
+AtomicSwap:
+	ll	$2,0($4)
+	nop
+	move	$8,$5
+	sc	$8,0($4)
+	beq	$8,$0,AtomicSwap
+	nop
+	j	$31
+	nop
+	.end AtomicSwap
+
+	.set mips0
+	.set reorder
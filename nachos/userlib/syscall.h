@@ -62,6 +62,25 @@
 #define SC_FSLIST        33
 #define SC_SYS_TIME	 34 
 #define SC_MMAP		 35 
+#define SC_FUTEX_WAIT	 36
+#define SC_FUTEX_WAKE	 37
+#define SC_RWLOCK_CREATE  38
+#define SC_RWLOCK_DESTROY 39
+#define SC_RWLOCK_READ	 40
+#define SC_RWLOCK_WRITE	 41
+#define SC_RWLOCK_RELEASE 42
+#define SC_BARRIER_CREATE 43
+#define SC_BARRIER_DESTROY 44
+#define SC_BARRIER_WAIT	 45
+#define SC_SLEEP	 46
+#define SC_P_TIMED	 47
+#define SC_RING_SETUP	 48
+#define SC_RING_ENTER	 49
+#define SC_SET_PRIORITY	 50
+#define SC_FORK		 51
+#define SC_MUNMAP	 52
+#define SC_MSYNC	 53
+#define SC_SBRK		 54
 
 #ifndef IN_ASM
 
@@ -97,6 +116,15 @@ typedef int ThreadId;
  */
 ThreadId Exec(char *name);
 
+/* Create a copy of the current process, running the same program,
+ * with a copy of the calling thread only. Memory is shared
+ * copy-on-write, so nothing is copied until one of the processes
+ * writes to it. Returns the identifier of the thread of the new
+ * process in the parent, 0 in the child, and a negative number on
+ * error (e.g. the process has mapped files).
+ */
+ThreadId Fork(void);
+
 /* Create a new thread in the current process
  * Return thread identifier
  */
@@ -111,6 +139,18 @@ int Join(ThreadId id);
  */
 void Yield();		
 
+/* Block the calling thread during ticks units of simulated time.
+ * Other threads keep running meanwhile.
+ */
+void Sleep(int ticks);
+
+/* Set the priority of the calling thread, from 0 (the default, and
+ * the lowest) to 7. The ready thread of highest priority always runs
+ * first. Returns the previous priority, or a negative number if
+ * priority is out of range.
+ */
+int SetPriority(int priority);
+
 /*! Print the last error message with the personalized one "mess" */
 void PError(char *mess); 
 
@@ -202,6 +242,11 @@ int V(SemId sema);
 /* Do the operation V() on the semaphore sema */
 int P(SemId sema);
 
+/* Do the operation P() on the semaphore sema, waiting at most ticks.
+   Return 0 if the semaphore was taken, 1 on timeout, and a negative
+   number if an error occured */
+int PTimed(SemId sema, int ticks);
+
 /* System calls concerning locks management */
 typedef int LockId;
 
@@ -249,6 +294,44 @@ int CondSignal(CondId cond);
 */
 int CondBroadcast(CondId cond);
 
+/* System calls concerning reader-writer locks. */
+typedef int RWLockId;
+
+/* Create a reader-writer lock, initially free.
+   Return an identifier */
+RWLockId RWLockCreate(char * debug_name);
+
+/* Destroy a reader-writer lock.
+   Return a negative number if an error ocurred. */
+int RWLockDestroy(RWLockId id);
+
+/* Acquire the lock in shared mode: several readers may hold it at
+   the same time. Return a negative number if an error ocurred. */
+int RWLockRead(RWLockId id);
+
+/* Acquire the lock in exclusive mode.
+   Return a negative number if an error ocurred. */
+int RWLockWrite(RWLockId id);
+
+/* Release the lock, acquired either in shared or exclusive mode.
+   Return a negative number if an error ocurred. */
+int RWLockRelease(RWLockId id);
+
+/* System calls concerning barriers. */
+typedef int BarrierId;
+
+/* Create a barrier for count threads.
+   Return an identifier */
+BarrierId BarrierCreate(char * debug_name, int count);
+
+/* Destroy a barrier.
+   Return a negative number if an error ocurred. */
+int BarrierDestroy(BarrierId id);
+
+/* Wait until count threads have called BarrierWait on the barrier.
+   Return a negative number if an error ocurred. */
+int BarrierWait(BarrierId id);
+
 /******************************************************************/
 /* System calls concerning serial port and console */
 
@@ -267,5 +350,95 @@ int TtyReceive(char *mess,int length);
 */
 int Mmap(OpenFileId f, int size);
 
+/* Remove the mapping at addr (as returned by Mmap), after writing its
+   modified pages back to the file. Returns 0, or -1 on error.
+*/
+int Munmap(void *addr);
+
+/* Write back to the file the modified pages of the mapping holding
+   addr. Returns the number of pages written, or -1 on error.
+*/
+int Msync(void *addr);
+
+/* Move the end of the heap of the process by increment bytes (negative
+   to shrink it). The heap is made of zero-filled pages, which only use
+   physical memory once accessed. Returns the previous end of the heap,
+   or (void *)-1 on error.
+*/
+void *Sbrk(int increment);
+
+/******************************************************************/
+/* Futexes: kernel support for user-level synchronization (see
+   the n_mutex and n_cond functions of libnachos) */
+
+/* Block the calling thread on the word at addr, if it still contains val.
+   Returns 0 when woken up, 1 if *addr != val, a negative number on error.
+*/
+int FutexWait(int *addr, int val);
+
+/* Wake up at most count threads blocked on the word at addr.
+   Returns the number of threads woken up.
+*/
+int FutexWake(int *addr, int count);
+
+/* Atomic operations, implemented with LL/SC (not system calls) */
+
+/* If *addr == old, set it to newval. Returns the previous value of *addr. */
+int AtomicCas(int *addr, int old, int newval);
+
+/* Set *addr to val. Returns the previous value of *addr. */
+int AtomicSwap(int *addr, int val);
+
+/******************************************************************/
+/* System call ring: a submission queue and a completion queue shared
+   with the kernel, in memory of the process. Operations are queued
+   in the submission queue, then a single RingEnter trap executes all
+   of them and posts their results in the completion queue (see the
+   n_ring functions of libnachos).
+
+   Each index only grows (slot = index % RING_ENTRIES). sq_tail and
+   cq_head are written by the user, sq_head and cq_tail by the kernel.
+   A ring is meant to be driven by one thread at a time. */
+
+#define RING_ENTRIES	64
+
+/* Operations that may be queued */
+#define RING_OP_NOP	0
+#define RING_OP_READ	1	/* arg = (buffer, size, file) */
+#define RING_OP_WRITE	2	/* arg = (buffer, size, file) */
+#define RING_OP_P	3	/* arg = (sema) */
+#define RING_OP_V	4	/* arg = (sema) */
+
+/* Submission: same arguments as the corresponding system call */
+typedef struct {
+  int opcode;
+  int arg[3];
+  int user_data;	/* copied as is in the completion */
+} RingSqe;
+
+/* Completion: result of the system call, -1 on error */
+typedef struct {
+  int user_data;
+  int result;
+} RingCqe;
+
+typedef struct {
+  int sq_head;
+  int sq_tail;
+  int cq_head;
+  int cq_tail;
+  RingSqe sq[RING_ENTRIES];
+  RingCqe cq[RING_ENTRIES];
+} RingPage;
+
+/* Map the system call ring of the process in its address space (the
+   same ring is returned by later calls). Returns NULL on error. */
+RingPage *RingSetup();
+
+/* Execute at most count queued submissions (all of them if count <= 0).
+   Stops early when the completion queue is full. Returns the number of
+   submissions consumed, or a negative number if there is no ring. */
+int RingEnter(int count);
+
 #endif // IN_ASM
 #endif // SYSCALL_H
@@ -125,6 +125,48 @@ BitMap::NumClear()
     return count;
 }
 
+//----------------------------------------------------------------------
+// BitMap::FindRun
+/*! 	Return the number of the first bit of the first run of "count"
+//	consecutive clear bits. The bits are not set.
+//
+//	Whole words are examined at once: a full word breaks the current
+//	run, and an empty word extends it by BITS_IN_WORD bits, so only
+//	the words partially used are scanned bit by bit.
+//
+//	\param count is the length of the run (at least 1)
+//	\return If there is no such run, return -1.
+*/
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int count)
+{
+    int run = 0;		// length of the current run of clear bits
+
+    ASSERT(count > 0);
+    for (int w = 0; w < numWords; w++) {
+	int base = w * BITS_IN_WORD;
+	if (map[w] == ~0U) {
+	    run = 0;
+	    continue;
+	}
+	if (map[w] == 0 && base + BITS_IN_WORD <= numBits) {
+	    run += BITS_IN_WORD;
+	    if (run >= count)
+		return base + BITS_IN_WORD - run;
+	    continue;
+	}
+	for (int i = base; i < base + BITS_IN_WORD && i < numBits; i++) {
+	    if (map[w] & (1U << (i % BITS_IN_WORD)))
+		run = 0;
+	    else if (++run == count)
+		return i - count + 1;
+	}
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // BitMap::Print
 /*! 	Print the contents of the bitmap, for debugging.
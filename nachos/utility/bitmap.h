@@ -49,6 +49,9 @@ class BitMap {
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear();		// Return the number of clear bits
+    int FindRun(int count);	// Return the # of the first bit of a run
+				// of "count" clear bits, without setting
+				// them. If there is none, return -1.
 
     void Print();		// Print contents of bitmap
     
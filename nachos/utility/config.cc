@@ -56,6 +56,13 @@ Config::Config(char *configname) {
   MakeDir=false;
   RemoveDir=false;
   ACIA=ACIA_NONE;
+  Replacement=REPLACE_CLOCK;
+  WorkingSetWindow=20000;
+  FaultAroundWindow=8;
+  SwapCacheSize=32768;
+  LocalReplacement=false;
+  PageFaultInterval=10000;
+  DiskCacheSize=64;
   strcpy(ProgramToRun,"");
 
   int nblignes=0;
@@ -244,6 +251,63 @@ Config::Config(char *configname) {
 	continue;
       }
       
+      if (strcmp(commande,"ReplacementPolicy") == 0){
+	char policy[LINE_LENGTH];
+	if (sscanf(ligne," %s = %s ",commande,policy)==2) {
+	  if (strcmp(policy,"Clock")==0)
+	    Replacement = REPLACE_CLOCK;
+	  else if (strcmp(policy,"WSClock")==0)
+	    Replacement = REPLACE_WSCLOCK;
+	  else if (strcmp(policy,"2Q")==0)
+	    Replacement = REPLACE_2Q;
+	  else fail(nblignes,configname,ligne);
+	}
+	else fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"WorkingSetWindow") == 0){
+	if(sscanf(ligne," %s = %i ",commande,&WorkingSetWindow)!=2)
+	  fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"FaultAroundWindow") == 0){
+	if(sscanf(ligne," %s = %i ",commande,&FaultAroundWindow)!=2
+	   || FaultAroundWindow < 1)
+	  fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"SwapCacheSize") == 0){
+	if(sscanf(ligne," %s = %i ",commande,&SwapCacheSize)!=2
+	   || SwapCacheSize < 0)
+	  fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"LocalReplacement") == 0){
+	int v;
+	if(sscanf(ligne," %s = %i ",commande,&v)==2)
+	  LocalReplacement = (v != 0);
+	else fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"PageFaultInterval") == 0){
+	if(sscanf(ligne," %s = %i ",commande,&PageFaultInterval)!=2
+	   || PageFaultInterval < 1)
+	  fail(nblignes,configname,ligne);
+	continue;
+      }
+
+      if (strcmp(commande,"DiskCacheSize") == 0){
+	if(sscanf(ligne," %s = %i ",commande,&DiskCacheSize)!=2
+	   || DiskCacheSize < 0)
+	  fail(nblignes,configname,ligne);
+	continue;
+      }
+
       if (strcmp(commande,"NumPortLoc") == 0){
 	if(sscanf(ligne," %s = %i ",commande,&NumPortLoc)!=2)
 	  fail(nblignes,configname,ligne);
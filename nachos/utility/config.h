@@ -22,6 +22,11 @@
 #define ACIA_BUSY_WAITING 1
 #define ACIA_INTERRUPT 2
 
+/* Page replacement policies */
+#define REPLACE_CLOCK 0
+#define REPLACE_WSCLOCK 1
+#define REPLACE_2Q 2
+
 /*! \brief Defines Nachos hardware and software configuration 
 *
 * Used to avoid recompiling Nachos when a change in the configuration
@@ -58,6 +63,15 @@ class Config {
   int MagicSize;           //!< Size of an integer 
   int UserStackSize;       //!< Stack size of user threads in bytes
 
+  // Virtual memory configuration
+  int Replacement;         //!< Page replacement policy (REPLACE_CLOCK, REPLACE_WSCLOCK or REPLACE_2Q)
+  int WorkingSetWindow;    //!< WSClock: a page unused for more ticks than this is out of the working set
+  int FaultAroundWindow;   //!< Maximum number of pages brought in by a page fault
+  int SwapCacheSize;       //!< Bytes of compressed pages kept in memory in front of the swap disk (0: none)
+  bool LocalReplacement;   //!< Each process replaces its own pages beyond its resident set target
+  int PageFaultInterval;   //!< Local replacement: faults closer than this (in ticks) grow the resident set
+  int DiskCacheSize;       //!< Number of sectors of the disk buffer cache (0: none)
+
   // Configuration of actions to be done when Nachos is started and exited
   int NbCopy;              //!< Number of files to copy
   bool ListDir;            //!< List all the files and directories if true
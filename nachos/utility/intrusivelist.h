@@ -0,0 +1,258 @@
+/*! \file intrusivelist.h
+    \brief Data structures to manage intrusive doubly linked lists.
+
+    Unlike the LISP-like lists of list.h, an intrusive list does not
+    allocate a cell for each item it holds: the links are stored in a
+    ListHook embedded in the item itself (a thread, a physical page
+    descriptor, ...). Inserting or removing an item thus never calls
+    new or delete, and removing an arbitrary item is done in constant
+    time.
+
+    An item may be on several intrusive lists at the same time,
+    provided it embeds one hook per list. The hook used by a given
+    list is chosen when the list is built, by giving a pointer to the
+    corresponding member of the item class.
+
+    As for list.h, we assume mutual exclusion is provided by the
+    caller (typically by disabling interrupts).
+
+ Copyright (c) 1992-1993 The Regents of the University of California.
+ All rights reserved.  See copyright.h for copyright notice and limitation
+ of liability and disclaimer of warranty provisions.
+*/
+
+#ifndef INTRUSIVELIST_H
+#define INTRUSIVELIST_H
+
+#include "kernel/copyright.h"
+#include "utility/utility.h"
+
+template <class T> class IntrusiveList;
+
+/*! \brief Definition of the links embedded in an item of an intrusive list
+//
+// An item must contain one ListHook per intrusive list it may be
+// inserted in. The hook is private to the list while the item is
+// linked; it must not be modified by the item itself.
+*/
+template <class T>
+class ListHook {
+public:
+  //! Previous hook on the list, NULL if this is the first.
+  ListHook<T> *prev;
+
+  //! Next hook on the list, NULL if this is the last.
+  ListHook<T> *next;
+
+  //! Item containing this hook (set when the item is inserted).
+  T *item;
+
+  //! List the item is currently linked in, NULL if none.
+  IntrusiveList<T> *list;
+
+  //----------------------------------------------------------------------
+  // ListHook::ListHook
+  //!	Initializes a hook, which is not linked in any list yet.
+  //----------------------------------------------------------------------
+  ListHook(){
+    prev = next = NULL;
+    item = NULL;
+    list = NULL;
+  };
+
+  //----------------------------------------------------------------------
+  // ListHook::IsLinked
+  //!      \return true if the item is currently on a list.
+  //----------------------------------------------------------------------
+  bool IsLinked(){ return list != NULL; };
+};
+
+/*! \brief Definition of a generic intrusive doubly-linked list
+//
+// All operations are done in constant time and never allocate
+// memory, except Search and Mapcar which walk through the list.
+*/
+template <class T>
+class IntrusiveList {
+public:
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::IntrusiveList
+  /*!	Initialize a list, empty to start with.
+  //
+  //	\param hookMember is the member of T used to link items in this
+  //		list (e.g. &Thread::queueHook).
+  */
+  //----------------------------------------------------------------------
+  IntrusiveList(ListHook<T> T::*hookMember){
+    hook = hookMember;
+    first = last = NULL;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::~IntrusiveList
+  /*!	Prepare a list for deallocation. The items still on the list are
+  //	unlinked, but not de-allocated.
+  */
+  //----------------------------------------------------------------------
+  ~IntrusiveList(){
+    while (Remove() != NULL)
+      ;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Prepend
+  /*!      Put an item on the front of the list.
+  //
+  //	\param item is the thing to put on the list. It must not be
+  //		linked in another list through the same hook.
+  */
+  //----------------------------------------------------------------------
+  void Prepend(T *item){
+    ListHook<T> *h = &(item->*hook);
+
+    ASSERT(!h->IsLinked());
+    h->item = item;
+    h->list = this;
+    h->prev = NULL;
+    h->next = first;
+    if (first == NULL)
+      last = h;
+    else
+      first->prev = h;
+    first = h;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Append
+  /*!      Append an item to the end of the list.
+  //
+  //	\param item is the thing to put on the list. It must not be
+  //		linked in another list through the same hook.
+  */
+  //----------------------------------------------------------------------
+  void Append(T *item){
+    ListHook<T> *h = &(item->*hook);
+
+    ASSERT(!h->IsLinked());
+    h->item = item;
+    h->list = this;
+    h->next = NULL;
+    h->prev = last;
+    if (last == NULL)
+      first = h;
+    else
+      last->next = h;
+    last = h;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Remove
+  /*!      Remove the first item from the front of the list.
+  //
+  // \return
+  //	Pointer to removed item, NULL if nothing on the list.
+  */
+  //----------------------------------------------------------------------
+  T *Remove(){
+    if (first == NULL)
+      return NULL;
+    T *item = first->item;
+    RemoveItem(item);
+    return item;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::RemoveItem
+  /*!      Remove the specified item from the list if present
+  //
+  // \param
+  //    item: pointer to the element we want to remove
+  */
+  //----------------------------------------------------------------------
+  void RemoveItem(T *item){
+    ListHook<T> *h = &(item->*hook);
+
+    if (h->list != this)
+      return;
+    if (h->prev == NULL)
+      first = h->next;
+    else
+      h->prev->next = h->next;
+    if (h->next == NULL)
+      last = h->prev;
+    else
+      h->next->prev = h->prev;
+    h->prev = h->next = NULL;
+    h->list = NULL;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Contains
+  /*!      \return true if the item is on this list. The item must
+  //	still be allocated.
+  */
+  //----------------------------------------------------------------------
+  bool Contains(T *item){ return (item->*hook).list == this; };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Search
+  /*!      Search for an element in the list, by walking through it.
+  //	Unlike Contains, item is never dereferenced, so it may be
+  //	a dangling pointer.
+  //
+  // \return
+  //	true if the element is found, false otherwise
+  */
+  //----------------------------------------------------------------------
+  bool Search(T *item){
+    for (ListHook<T> *h = first; h != NULL; h = h->next)
+      if (h->item == item)
+	return true;
+    return false;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::IsEmpty
+  //!      \return true if the list is empty (has no items).
+  //----------------------------------------------------------------------
+  bool IsEmpty(){ return first == NULL; };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::getFirst
+  //!      \return the first item of the list, NULL if it is empty.
+  //----------------------------------------------------------------------
+  T *getFirst(){ return (first == NULL) ? NULL : first->item; };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::getNext
+  //!      \return the item following item on the list, NULL if none.
+  //----------------------------------------------------------------------
+  T *getNext(T *item){
+    ListHook<T> *h = (item->*hook).next;
+    return (h == NULL) ? NULL : h->item;
+  };
+
+  //----------------------------------------------------------------------
+  // IntrusiveList::Mapcar
+  /*!	Apply a function to each item on the list, by walking through
+  //	the list, one element at a time.
+  //
+  //	\param func is the procedure to apply to each element of the list.
+  */
+  //----------------------------------------------------------------------
+  void Mapcar(VoidFunctionPtr func){
+    for (ListHook<T> *h = first; h != NULL; h = h->next)
+      (*func)((int64_t)h->item);
+  };
+
+private:
+  //! Member of T holding the links of this list
+  ListHook<T> T::*hook;
+  //! Head of the list, NULL if list is empty.
+  ListHook<T> *first;
+  //! Last element of list.
+  ListHook<T> *last;
+};
+
+#endif // INTRUSIVELIST_H
@@ -288,18 +288,34 @@ class List {
     
   //----------------------------------------------------------------------
   // List::RemoveItem
-  /*!      Remove the specified item from the list if present
+  /*!      Remove the specified item from the list if present. The
+  //	order of the other elements is preserved, so this can be used
+  //	on sorted lists.
   // 
   // \return
-  //	none
+  //	true if the item was found and removed
   //
   // \param 
   //    item: pointer to the element we want to remove
   */
   //----------------------------------------------------------------------    
-  void RemoveItem(void *item){
-    void *temp;
-    while ((temp=this->Remove()) != item) this->Append(temp);
+  bool RemoveItem(void *item){
+    ListElement<Priority> *prev = NULL;
+
+    for (ListElement<Priority> *ptr = first; ptr != NULL; ptr = ptr->next) {
+      if (ptr->item == item) {
+	if (prev == NULL)
+	  first = ptr->next;
+	else
+	  prev->next = ptr->next;
+	if (last == ptr)
+	  last = prev;
+	delete ptr;
+	return true;
+      }
+      prev = ptr;
+    }
+    return false;
   };
 
   //----------------------------------------------------------------------
@@ -11,6 +11,7 @@
 #include "kernel/copyright.h"
 #include "kernel/system.h"
 #include "utility/stats.h"
+#include "drivers/drvDisk.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -59,6 +60,8 @@ Statistics::Print()
 	 totalTicks,g_cfg->ProcessorFrequency,
 	 cycle_to_sec(totalTicks,g_cfg->ProcessorFrequency),
 	 cycle_to_nano(totalTicks,g_cfg->ProcessorFrequency));
+  if (g_disk_driver != NULL)
+    g_disk_driver->PrintStats();
 }
 
 ProcessStat*
@@ -12,6 +12,7 @@ Routines for the page fault managerPage Fault Manager
 #include "vm/swapManager.h"
 #include "vm/physMem.h"
 #include "vm/pagefaultmanager.h"
+#include "vm/pagewait.h"
 #include "kernel/addrspace.h"
 
 PageFaultManager::PageFaultManager() {
@@ -23,6 +24,42 @@ PageFaultManager::PageFaultManager() {
 PageFaultManager::~PageFaultManager() {
 }
 
+//-----------------------------------------------------------------
+// SameSource
+/*! \return true if virtual page virtualPage+n can be read in the
+//  same transfer as virtualPage: it is neither resident nor under
+//  I/O, and it is stored right after virtualPage+n-1 in the same
+//  backing store (mapped file, executable file or swap). Pages of
+//  the executable already in the text page cache are not read again.
+//
+//  \param as the address space of the pages
+//  \param virtualPage the faulting page
+//  \param n distance from the faulting page
+//  \param f the file mapped at virtualPage, NULL if none
+*/
+//-----------------------------------------------------------------
+static bool SameSource(AddrSpace *as, int virtualPage, int n, OpenFile *f)
+{
+  TranslationTable *tt = as->translationTable;
+  int ad = tt->getAddrDisk(virtualPage);
+  int vp = virtualPage + n;
+
+  if (vp >= tt->getMaxNumPages() || tt->getBitValid(vp) || tt->getBitIo(vp)
+      || as->findMappedFile(vp * g_cfg->PageSize) != f)
+    return false;
+  if (f == NULL && tt->getBitSwap(virtualPage)) // swap file
+    return tt->getBitSwap(vp) && tt->getAddrDisk(vp) == ad + n;
+  if (f == NULL && (tt->getBitSwap(vp) || ad == -1)) // anonymous page
+    return false;
+  if (tt->getAddrDisk(vp) != ad + n * g_cfg->PageSize)
+    return false;
+  if (f == NULL && as->IsSharedText(vp)) {
+    int sector = g_current_thread->GetProcessOwner()->exec_file->GetHeaderSector();
+    return g_physical_mem_manager->LookupText(sector, ad + n * g_cfg->PageSize) == -1;
+  }
+  return true;
+}
+
 // ExceptionType PageFault(int virtualPage)
 /*! 	
 //	This method is called by the Memory Management Unit when there is a 
@@ -34,13 +71,43 @@ PageFaultManager::~PageFaultManager() {
 //      - anonymous mappings (stack/bss) $\Rightarrow$ new
 //        page from the MemoryManager (1st time only), or swap file
 //
+//      Fault-around: the following virtual pages stored next to the
+//      faulting one in the same file are read in the same transfer.
+//      The number of pages read adapts to the access pattern of the
+//      address space: it doubles, up to g_cfg->FaultAroundWindow,
+//      each time a fault hits the page following those brought in
+//      by the previous fault, and falls back to one page otherwise.
+//      Pages are only read ahead into free physical pages, and stay
+//      unreferenced until used, so that they are replaced first.
+//      Pages swapped out together are always read back together, up
+//      to SWAP_CLUSTER pages, whatever the window: the swap manager
+//      allocates their sectors in clusters.
+//
+//      The physical pages are reserved (and locked) before the I/O,
+//      and the data is read directly into them.
+//
+//      Read-only pages of the executable file are looked up in the
+//      text page cache first: a page already loaded by another
+//      process running the same program is mapped without any I/O.
+//      Pages read from the executable are entered in the cache.
+//
+//      With local replacement, the resident set target of the
+//      address space is adjusted first by the page fault frequency,
+//      and the thread may be suspended by admission control (see
+//      PhysicalMemManager::PageFaultFrequency).
+//
+//      An anonymous page read before being written is mapped to the
+//      zero page, copy-on-write: it only gets its own physical page
+//      (and possibly swap space) once written.
+//
 //	\param virtualPage the virtual page subject to the page fault
 //	  (supposed to be between 0 and the
 //        size of the address space, and supposed to correspond to a
 //        page mapped to something [code/data/bss/...])
+//	\param writing true if the fault was raised by a write access
 //	\return the exception (generally the NO_EXCEPTION constant)
 */  
-ExceptionType PageFaultManager::PageFault(int virtualPage) 
+ExceptionType PageFaultManager::PageFault(int virtualPage, bool writing) 
 {
 #ifndef ETUDIANTS_TP
   printf("**** Warning: page fault manager is not implemented yet\n");
@@ -49,11 +116,14 @@ ExceptionType PageFaultManager::PageFault(int virtualPage)
 #endif
 #ifdef ETUDIANTS_TP
   TranslationTable* tt = g_machine->mmu->translationTable;
-  char* buffer = new char[g_cfg->PageSize];
   AddrSpace *as = g_current_thread->GetProcessOwner()->addrspace;
+  int count = 1; // number of pages read
+
+  if (g_cfg->LocalReplacement)
+    g_physical_mem_manager->PageFaultFrequency(as);
 
   while(tt->getBitIo(virtualPage)) {
-      g_current_thread->Yield();
+      g_page_waits->Wait(as, virtualPage);
   }
   if (tt->getBitValid(virtualPage)) { // page fault has been fixed
     return NO_EXCEPTION;
@@ -63,41 +133,106 @@ ExceptionType PageFaultManager::PageFault(int virtualPage)
 
   int ad = tt->getAddrDisk(virtualPage);
   OpenFile *f = as->findMappedFile(virtualPage * g_cfg->PageSize);
-  if (f != NULL) { // mapped file
-    // printf("readat\n");
-    f->ReadAt(buffer, g_cfg->PageSize, ad);
-  } else { // default
-    if (tt->getBitSwap(virtualPage) == 0) {
-      if(tt->getAddrDisk(virtualPage) == -1) { // anonymous page
-        memset(buffer,0,g_cfg->PageSize);
-      } else { // read from file
-        g_current_thread->GetProcessOwner()->exec_file->ReadAt(buffer, g_cfg->PageSize, ad);
-      }
-    } else { // page on disk
-      int num_sector = tt->getAddrDisk(virtualPage);
-      while(num_sector == -1) {
-        g_current_thread->Yield();
-        num_sector = tt->getAddrDisk(virtualPage);
-      }
-      g_swap_manager->GetPageSwap(num_sector, buffer);
+  if (f == NULL && tt->getBitSwap(virtualPage)) {
+    while(ad == -1) { // page being written to the swap
+      g_page_waits->Wait(as, virtualPage);
+      ad = tt->getAddrDisk(virtualPage);
     }
   }
 
-  long physPage = g_physical_mem_manager->AddPhysicalToVirtualMapping(g_current_thread->GetProcessOwner()->addrspace,virtualPage);
+  // Anonymous page not written yet
+  if (f == NULL && !writing && !tt->getBitSwap(virtualPage) && ad == -1) {
+    DEBUG('v', (char *)"Page fault at %d, zero page\n", virtualPage);
+    as->MapZeroPage(virtualPage);
+    return NO_EXCEPTION;
+  }
+
+  // Share the page with the other processes running the program
+  int textSector = -1;
+  if (as->IsSharedText(virtualPage)) {
+    textSector = g_current_thread->GetProcessOwner()->exec_file->GetHeaderSector();
+    int pp = g_physical_mem_manager->LookupText(textSector, ad);
+    if (pp != -1) {
+      DEBUG('v', (char *)"Page fault at %d, shared text page %d\n",
+	    virtualPage, pp);
+      g_physical_mem_manager->ShareMapping(pp, as, virtualPage);
+      tt->setPhysicalPage(virtualPage, pp);
+      tt->clearBitIo(virtualPage);
+      tt->clearBitM(virtualPage);
+      tt->setBitU(virtualPage);
+      tt->setBitValid(virtualPage);
+      g_page_waits->Wake(as, virtualPage);
+      return NO_EXCEPTION;
+    }
+  }
+
+  // Detect sequential fault streams
+  if (virtualPage == as->faultNext) {
+    as->faultWindow *= 2;
+    if (as->faultWindow > g_cfg->FaultAroundWindow)
+      as->faultWindow = g_cfg->FaultAroundWindow;
+  } else
+    as->faultWindow = 1;
+
+  // Choose the pages read with the faulting one
+  int window = as->faultWindow;
+  if (f == NULL && tt->getBitSwap(virtualPage) && window < SWAP_CLUSTER)
+    window = SWAP_CLUSTER;
+  while (count < window && count < MAX_FAULT_AROUND
+	 && count < g_physical_mem_manager->NumFreePages()
+	 && SameSource(as, virtualPage, count, f)) {
+    tt->setBitIo(virtualPage + count);
+    count++;
+  }
+  as->faultNext = virtualPage + count;
+  DEBUG('v', (char *)"Page fault at %d, %d page(s) read\n", virtualPage, count);
 
-  memcpy(&(g_machine->mainMemory[physPage * g_cfg->PageSize]), buffer, g_cfg->PageSize);
+  // Reserve the physical pages first. They stay locked while the
+  // data is read directly into them. An anonymous page gets a page
+  // already filled with zeroes by the memory manager
+  bool anonymous = (f == NULL && !tt->getBitSwap(virtualPage) && ad == -1);
+  long frames[MAX_FAULT_AROUND];
+  char *pages[MAX_FAULT_AROUND];
+  for (int i = 0; i < count; i++) {
+    frames[i] = g_physical_mem_manager->AddPhysicalToVirtualMapping(as, virtualPage + i,
+								    anonymous);
+    pages[i] = (char *)&(g_machine->mainMemory[frames[i] * g_cfg->PageSize]);
+  }
 
-  tt->setPhysicalPage(virtualPage,physPage);
+  if (f == NULL && tt->getBitSwap(virtualPage)) { // page on disk
+    g_swap_manager->GetPagesSwap(ad, count, pages);
+  } else if (!anonymous) { // mapped file, or read from the executable file
+    OpenFile *file = (f != NULL) ? f : g_current_thread->GetProcessOwner()->exec_file;
+    for (int i = 0; i < count; i++) {
+      int n = file->ReadAt(pages[i], g_cfg->PageSize, ad + i * g_cfg->PageSize);
+      if (n < g_cfg->PageSize) // end of file
+	memset(pages[i] + n, 0, g_cfg->PageSize - n);
+    }
+  }
 
-  tt->clearBitIo(virtualPage);
-  tt->clearBitM(virtualPage);
-  tt->setBitU(virtualPage);
+  for (int i = 0; i < count; i++) {
+    int vp = virtualPage + i;
+    long physPage = frames[i];
 
-  tt->setBitValid(virtualPage);
+    tt->setPhysicalPage(vp,physPage);
 
-  g_physical_mem_manager->UnlockPage(physPage);
+    tt->clearBitIo(vp);
+    tt->clearBitM(vp);
+    // Pages read ahead stay unreferenced until they are really used
+    if (i == 0)
+      tt->setBitU(vp);
+    else
+      tt->clearBitU(vp);
 
-  delete[] buffer;
+    tt->setBitValid(vp);
+
+    if (textSector != -1 && as->IsSharedText(vp))
+      g_physical_mem_manager->CacheText(physPage, textSector,
+					ad + i * g_cfg->PageSize);
+
+    g_physical_mem_manager->UnlockPage(physPage);
+    g_page_waits->Wake(as, vp);
+  }
 
   return NO_EXCEPTION;
 #endif
@@ -13,6 +13,9 @@
 
 #include "machine/machine.h"
 
+//! Maximum number of pages brought in by a single page fault
+#define MAX_FAULT_AROUND 32
+
 /*! \brief Defines the page fault manager
    This object manages the page fault of the simulated MIPS processor 
    for the Nachos kernel.
@@ -24,7 +27,7 @@ public:
 
   ~PageFaultManager();
  
-  ExceptionType PageFault(int virtualPage); //!< Page faut handler
+  ExceptionType PageFault(int virtualPage, bool writing); //!< Page faut handler
 };
 
 #endif // PFM_H
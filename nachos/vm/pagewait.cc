@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------
+/*! \file pagewait.cc
+//  \brief Routines to wait for pages under I/O
+//
+//  The kernel is not preemptive: the state of a page cannot change
+//  between the test made by the caller of Wait and the blocking of
+//  the thread, as long as the caller does not yield in between.
+//  Interrupts are only disabled because Sleep requires it.
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.
+//  See copyright_insa.h for copyright notice and limitation
+//  of liability and disclaimer of warranty provisions.
+*/
+//-----------------------------------------------------------------
+
+#include "kernel/system.h"
+#include "kernel/scheduler.h"
+#include "vm/pagewait.h"
+
+//-----------------------------------------------------------------
+// PageWaitTable::PageWaitTable
+//
+/*! Initialize the table with empty wait queues.
+*/
+//-----------------------------------------------------------------
+PageWaitTable::PageWaitTable() {
+  for (int i = 0; i < PAGE_WAIT_HASH_SIZE; i++)
+    buckets[i] = new IntrusiveList<Thread>(&Thread::queueHook);
+}
+
+//-----------------------------------------------------------------
+// PageWaitTable::~PageWaitTable
+//
+/*! De-allocate the wait queues.
+*/
+//-----------------------------------------------------------------
+PageWaitTable::~PageWaitTable() {
+  for (int i = 0; i < PAGE_WAIT_HASH_SIZE; i++)
+    delete buckets[i];
+}
+
+//-----------------------------------------------------------------
+// PageWaitTable::Bucket
+//
+/*! Return the wait queue of the threads blocked on (channel, key).
+*/
+//-----------------------------------------------------------------
+IntrusiveList<Thread> *PageWaitTable::Bucket(void *channel, int key) {
+  uint32_t h = ((uint32_t)(intptr_t)channel >> 4) ^ (uint32_t)key;
+  return buckets[h % PAGE_WAIT_HASH_SIZE];
+}
+
+//-----------------------------------------------------------------
+// PageWaitTable::Wait
+//
+/*! Block the current thread until a Wake on (channel, key). The
+//  caller must check the state of the page again when woken up.
+//
+//  \param channel is the address space of a virtual page, or the
+//         physical memory manager for a physical page
+//  \param key is the number of the page
+*/
+//-----------------------------------------------------------------
+void PageWaitTable::Wait(void *channel, int key) {
+  IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+  DEBUG('v', (char *)"%s waits for page %d\n", g_current_thread->GetName(),
+	key);
+  g_current_thread->waitChannel = channel;
+  g_current_thread->waitKey = key;
+  Bucket(channel, key)->Append(g_current_thread);
+  g_current_thread->Sleep();
+
+  g_machine->interrupt->SetStatus(oldLevel);
+}
+
+//-----------------------------------------------------------------
+// PageWaitTable::Wake
+//
+/*! Wake up all the threads blocked on (channel, key), in FIFO order.
+//
+//  \param channel is the address space of a virtual page, or the
+//         physical memory manager for a physical page
+//  \param key is the number of the page
+*/
+//-----------------------------------------------------------------
+void PageWaitTable::Wake(void *channel, int key) {
+  IntStatus oldLevel = g_machine->interrupt->SetStatus(INTERRUPTS_OFF);
+
+  IntrusiveList<Thread> *queue = Bucket(channel, key);
+  Thread *t = queue->getFirst();
+  while (t != NULL) {
+    Thread *next = queue->getNext(t);
+    if (t->waitChannel == channel && t->waitKey == key) {
+      queue->RemoveItem(t);
+      g_scheduler->ReadyToRun(t);
+    }
+    t = next;
+  }
+
+  g_machine->interrupt->SetStatus(oldLevel);
+}
@@ -0,0 +1,53 @@
+//-----------------------------------------------------------------
+/*! \file pagewait.h
+    \brief Data structures to wait for pages under I/O
+
+    A thread which needs a page under I/O (page fault, eviction,
+    write-back) or a locked physical page blocks until the page is
+    available, instead of yielding the processor in a loop. Blocked
+    threads are linked, through their queue hook, into a fixed hash
+    table of wait queues indexed by a channel (the address space of
+    a virtual page, or the physical memory manager for a physical
+    page) and a key (the page number).
+
+    Wake-ups wake all the threads waiting on a channel and key, which
+    then check again the state of the page.
+
+    Copyright (c) 1999-2000 INSA de Rennes.
+    All rights reserved.
+    See copyright_insa.h for copyright notice and limitation
+    of liability and disclaimer of warranty provisions.
+*/
+//-----------------------------------------------------------------
+
+#ifndef __PAGEWAIT_H
+#define __PAGEWAIT_H
+
+#include "kernel/copyright.h"
+#include "kernel/thread.h"
+#include "utility/intrusivelist.h"
+
+//! Number of wait queues of the page wait table
+#define PAGE_WAIT_HASH_SIZE 64
+
+/*! \brief Defines the table of wait queues of the pages
+*/
+class PageWaitTable {
+public:
+  PageWaitTable();   //!< Build an empty table
+  ~PageWaitTable();  //!< De-allocate the table (nobody may be waiting)
+
+  //! Block the current thread until Wake(channel, key)
+  void Wait(void *channel, int key);
+
+  //! Wake up all the threads blocked on (channel, key)
+  void Wake(void *channel, int key);
+
+private:
+  //! Wait queue where threads blocked on (channel, key) are linked
+  IntrusiveList<Thread> *Bucket(void *channel, int key);
+
+  IntrusiveList<Thread> *buckets[PAGE_WAIT_HASH_SIZE]; //!< Wait queues
+};
+
+#endif // __PAGEWAIT_H
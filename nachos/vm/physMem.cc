@@ -11,12 +11,13 @@
 
 #include <unistd.h>
 #include "vm/physMem.h"
+#include "vm/pagewait.h"
 
 //-----------------------------------------------------------------
 // PhysicalMemManager::PhysicalMemManager
 //
-/*! Constructor. It simply clears all the page flags and inserts them in the
-// free_page_list to indicate that the physical pages are free
+/*! Constructor. It simply clears all the page flags and pushes them on
+// the free_stack to indicate that the physical pages are free
 */
 //-----------------------------------------------------------------
 PhysicalMemManager::PhysicalMemManager() {
@@ -24,19 +25,70 @@ PhysicalMemManager::PhysicalMemManager() {
   long i;
 
   tpr = new struct tpr_c[g_cfg->NumPhysPages];
+  free_stack = new int[g_cfg->NumPhysPages];
+  numFree = 0;
 
-  for (i=0;i<g_cfg->NumPhysPages;i++) {
+  // Push the pages in reverse order, so that page 0 is allocated first
+  for (i=g_cfg->NumPhysPages-1;i>=0;i--) {
     tpr[i].free=true;
     tpr[i].locked=false;
     tpr[i].owner=NULL;
-    free_page_list.Append((void*)i);
+    tpr[i].refCount=0;
+    tpr[i].sharers=NULL;
+    tpr[i].textSector=-1;
+    free_stack[numFree++] = i;
+  }
+  for (i=0;i<TEXT_CACHE_SIZE;i++)
+    textCache[i] = new IntrusiveList<tpr_c>(&tpr_c::textHook);
+  numTextHits = 0;
+
+  // Reserve the zero page for good
+  zeroPage = free_stack[--numFree];
+  tpr[zeroPage].free = false;
+  tpr[zeroPage].locked = true;
+  memset(&(g_machine->mainMemory[zeroPage * g_cfg->PageSize]), 0,
+	 g_cfg->PageSize);
+  lowWatermark = g_cfg->NumPhysPages / 32;
+  if (lowWatermark < 2)
+    lowWatermark = 2;
+  highWatermark = g_cfg->NumPhysPages / 8;
+  if (highWatermark < 4)
+    highWatermark = 4;
+  totalTarget = 0;
+  numActive = 0;
+  suspendedSpaces = new IntrusiveList<AddrSpace>(&AddrSpace::suspendHook);
+  numSuspensions = 0;
+  numZeroed = 0;
+  zeroTarget = g_cfg->NumPhysPages / 16;
+  if (zeroTarget < 4)
+    zeroTarget = 4;
+  numPreZeroed = numZeroHits = 0;
+  cleanHand = -1;
+  cleanerWakeUp = NULL;
+  cleanerIdle = false;
+  numCleaned = 0;
+
+  switch (g_cfg->Replacement) {
+  case REPLACE_WSCLOCK:
+    policy = new WSClockPolicy(this);
+    break;
+  case REPLACE_2Q:
+    policy = new TwoQPolicy(this);
+    break;
+  default:
+    policy = new ClockPolicy(this);
+    break;
   }
-  i_clock=-1;
 }
 
 PhysicalMemManager::~PhysicalMemManager() {
-  // Empty free page list
-  while (!free_page_list.IsEmpty()) (void)free_page_list.Remove();
+  delete[] free_stack;
+
+  for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+    delete textCache[i];
+  delete policy;
+  delete suspendedSpaces;
+  // NB: cleanerWakeUp is not deleted, the cleaner is still waiting on it
 
   // Delete physical page table
   delete[] tpr;
@@ -46,8 +98,8 @@ PhysicalMemManager::~PhysicalMemManager() {
 // PhysicalMemManager::RemovePhysicalToVitualMapping
 //
 /*! This method releases an unused physical page by clearing the
-//  corresponding bit in the page_flags bitmap structure, and adding
-//  it in the free_page_list.
+//  corresponding bit in the page_flags bitmap structure, and pushing
+//  it on the free_stack.
 //
 //  \param num_page is the number of the real page to free
 */
@@ -55,15 +107,243 @@ PhysicalMemManager::~PhysicalMemManager() {
 void PhysicalMemManager::RemovePhysicalToVirtualMapping(long num_page) {
   // Check that the page is not already free 
   ASSERT(!tpr[num_page].free);
+  ASSERT(tpr[num_page].refCount == 1);
+
+  policy->PageUnmapped(num_page);
+  UncacheText(num_page);
 
   // Update the physical page table entry
   tpr[num_page].free=true;
   tpr[num_page].locked=false;
+  tpr[num_page].refCount=0;
   if (tpr[num_page].owner->translationTable!=NULL) 
     tpr[num_page].owner->translationTable->clearBitValid(tpr[num_page].virtualPage);
+  SetOwner(num_page, NULL);
+  g_page_waits->Wake(this, num_page);
+
+  // Insert the page in the free stack
+  free_stack[numFree++] = num_page;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::ShareMapping
+//
+/*! Map a page in one more address space. Used by Fork, the page is
+//  then shared by the parent and the child (read-only, or
+//  copy-on-write).
+//
+//  \param num_page is the number of the real page
+//  \param owner is the address space of the new mapping
+//  \param virtualPage is the virtual page of the new mapping
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::ShareMapping(long num_page, AddrSpace *owner,
+				      int virtualPage) {
+  ASSERT(!tpr[num_page].free);
+  map_c *m = new map_c;
+  m->owner = owner;
+  m->virtualPage = virtualPage;
+  m->next = tpr[num_page].sharers;
+  tpr[num_page].sharers = m;
+  tpr[num_page].refCount++;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::UnmapPage
+//
+/*! Delete a mapping of a page. The page is freed with its last
+//  mapping; otherwise, if the owner's mapping is deleted, another
+//  mapping becomes the owner.
+//
+//  \param num_page is the number of the real page
+//  \param owner is the address space of the mapping
+//  \param virtualPage is the virtual page of the mapping
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::UnmapPage(long num_page, AddrSpace *owner,
+				   int virtualPage) {
+  ASSERT(!tpr[num_page].free);
+  if (tpr[num_page].refCount == 1) {
+    ASSERT(tpr[num_page].owner == owner
+	   && tpr[num_page].virtualPage == virtualPage);
+    RemovePhysicalToVirtualMapping(num_page);
+    return;
+  }
+
+  owner->translationTable->clearBitValid(virtualPage);
+  map_c **pm = &tpr[num_page].sharers;
+  if (tpr[num_page].owner == owner
+      && tpr[num_page].virtualPage == virtualPage) {
+    // The first sharer becomes the owner
+    SetOwner(num_page, (*pm)->owner);
+    tpr[num_page].virtualPage = (*pm)->virtualPage;
+  } else {
+    while ((*pm)->owner != owner || (*pm)->virtualPage != virtualPage) {
+      pm = &(*pm)->next;
+      ASSERT(*pm != NULL);
+    }
+  }
+  map_c *m = *pm;
+  *pm = m->next;
+  delete m;
+  tpr[num_page].refCount--;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::Mapping
+//
+/*! Get a mapping of a page.
+//
+//  \param page is the number of the real page
+//  \param k is the number of the mapping, from 0 (the owner) to
+//         refCount - 1
+//  \param owner is where to store the address space of the mapping
+//  \param virtualPage is where to store the virtual page
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::Mapping(int page, int k, AddrSpace **owner,
+				 int *virtualPage) {
+  ASSERT(k >= 0 && k < tpr[page].refCount);
+  if (k == 0) {
+    *owner = tpr[page].owner;
+    *virtualPage = tpr[page].virtualPage;
+    return;
+  }
+  map_c *m = tpr[page].sharers;
+  while (--k > 0)
+    m = m->next;
+  *owner = m->owner;
+  *virtualPage = m->virtualPage;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::IsDirty
+//
+/*! \return true if the page was modified, in any of its mappings,
+//  since it was last written back.
+*/
+//-----------------------------------------------------------------
+bool PhysicalMemManager::IsDirty(int page) {
+  AddrSpace *o;
+  int v;
+
+  for (int k = 0; k < tpr[page].refCount; k++) {
+    Mapping(page, k, &o, &v);
+    if (o->translationTable->getBitM(v))
+      return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::FreeSharers
+//
+/*! Forget all the mappings of a page but the owner's (once the page
+//  has been evicted from all of them).
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::FreeSharers(int page) {
+  while (tpr[page].sharers != NULL) {
+    map_c *m = tpr[page].sharers;
+    tpr[page].sharers = m->next;
+    delete m;
+  }
+  tpr[page].refCount = 1;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::TextBucket
+//
+/*! \return the bucket of the text page cache holding the page of
+//  the executable whose header is at sector, at offset in the file.
+*/
+//-----------------------------------------------------------------
+IntrusiveList<PhysicalMemManager::tpr_c> *
+PhysicalMemManager::TextBucket(int sector, int offset) {
+  uint32_t h = (uint32_t)sector * 31 + (uint32_t)offset / g_cfg->PageSize;
+  return textCache[h % TEXT_CACHE_SIZE];
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::LookupText
+//
+/*! Look for a physical page holding a read-only page of an
+//  executable file. The page can then be mapped with ShareMapping
+//  instead of being read again.
+//
+//  \param sector is the sector of the header of the executable file
+//  \param offset is the offset of the page in the file
+//  \return the physical page, -1 if the page is not cached, or if it
+//          is locked (being evicted)
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::LookupText(int sector, int offset) {
+  IntrusiveList<tpr_c> *bucket = TextBucket(sector, offset);
+
+  for (tpr_c *t = bucket->getFirst(); t != NULL; t = bucket->getNext(t))
+    if (t->textSector == sector && t->textOffset == offset) {
+      if (t->locked)
+	return -1;
+      numTextHits++;
+      return t - tpr;
+    }
+  return -1;
+}
 
-  // Insert the page in the free list
-  free_page_list.Prepend((void*)num_page);
+//-----------------------------------------------------------------
+// PhysicalMemManager::CacheText
+//
+/*! Enter a page freshly read from an executable file in the text
+//  page cache, unless another process already cached the same page
+//  in the meantime (the page then stays private).
+//
+//  \param num_page is the physical page
+//  \param sector is the sector of the header of the executable file
+//  \param offset is the offset of the page in the file
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::CacheText(long num_page, int sector, int offset) {
+  IntrusiveList<tpr_c> *bucket = TextBucket(sector, offset);
+
+  ASSERT(!tpr[num_page].free && tpr[num_page].textSector == -1);
+  for (tpr_c *t = bucket->getFirst(); t != NULL; t = bucket->getNext(t))
+    if (t->textSector == sector && t->textOffset == offset)
+      return;
+  tpr[num_page].textSector = sector;
+  tpr[num_page].textOffset = offset;
+  bucket->Append(&tpr[num_page]);
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::UncacheText
+//
+/*! Remove a page from the text page cache, if it is in it.
+//
+//  \param page is the physical page
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::UncacheText(int page) {
+  if (tpr[page].textSector == -1)
+    return;
+  TextBucket(tpr[page].textSector, tpr[page].textOffset)
+    ->RemoveItem(&tpr[page]);
+  tpr[page].textSector = -1;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::UncacheFile
+//
+/*! Remove the pages of a file from the text page cache, because the
+//  file is removed: the sector of its header may be reused by a new
+//  executable. The pages stay mapped by their current users.
+//
+//  \param sector is the sector of the header of the file
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::UncacheFile(int sector) {
+  for (int i = 0; i < g_cfg->NumPhysPages; i++)
+    if (tpr[i].textSector == sector)
+      UncacheText(i);
 }
 
 //-----------------------------------------------------------------
@@ -83,6 +363,21 @@ void PhysicalMemManager::UnlockPage(long num_page) {
   ASSERT(tpr[num_page].locked==true);
   ASSERT(tpr[num_page].free==false);
   tpr[num_page].locked = false;
+  g_page_waits->Wake(this, num_page);
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::WaitUnlocked
+//
+/*! Block the current thread until a locked page is unlocked (or
+//  freed). The caller must check the state of the page again.
+//
+//  \param num_page is the number of the real page
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::WaitUnlocked(long num_page) {
+  ASSERT(tpr[num_page].locked);
+  g_page_waits->Wait(this, num_page);
 }
 
 //-----------------------------------------------------------------
@@ -98,7 +393,25 @@ void PhysicalMemManager::ChangeOwner(long numPage, Thread* owner) {
   // Update statistics
   g_current_thread->GetProcessOwner()->stat->incrMemoryAccess();
   // Change the page owner
-  tpr[numPage].owner = owner->GetProcessOwner()->addrspace;
+  SetOwner(numPage, owner->GetProcessOwner()->addrspace);
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::SetOwner
+//
+/*! Change the owner of a page, keeping the number of resident pages
+//  of the address spaces up to date.
+//
+//  \param numPage is the concerned page
+//  \param owner is the new owner, NULL for a page being freed
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::SetOwner(long numPage, AddrSpace *owner) {
+  if (tpr[numPage].owner != NULL)
+    tpr[numPage].owner->residentPages--;
+  tpr[numPage].owner = owner;
+  if (owner != NULL)
+    owner->residentPages++;
 }
 
 //-----------------------------------------------------------------
@@ -107,16 +420,27 @@ void PhysicalMemManager::ChangeOwner(long numPage, Thread* owner) {
 /*! This method returns a new physical page number. If there is no
 //  page available, it evicts one page (page replacement algorithm).
 //
+//  With local replacement, an address space which owns as many
+//  pages as its resident set target evicts one of its own pages
+//  instead, and one more (put in the free stack) while it owns more
+//  than its target, so that it shrinks to its target.
+//
+//  A page for an anonymous page fault (zeroFill) is taken from the
+//  pool of free pages zeroed while the machine was idle, if any, and
+//  is zeroed here otherwise.
+//
 //  NB: this method locks the newly allocated physical page such that
 //      it is not stolen during the page fault resolution. Don't forget
 //      to unlock it
 //
 //  \param owner address space (for backlink)
 //  \param virtualPage is the number of virtualPage to link with physical page
+//  \param zeroFill is true if the page must be filled with zeroes
 //  \return A new physical page number.
 */
 //-----------------------------------------------------------------
-int PhysicalMemManager::AddPhysicalToVirtualMapping(AddrSpace* owner,int virtualPage) 
+int PhysicalMemManager::AddPhysicalToVirtualMapping(AddrSpace* owner,int virtualPage,
+						    bool zeroFill) 
 {
 #ifndef ETUDIANTS_TP
   printf("**** Warning: function AddPhysicalToVirtualMapping is not implemented\n");
@@ -124,13 +448,40 @@ int PhysicalMemManager::AddPhysicalToVirtualMapping(AddrSpace* owner,int virtual
   return (0);
 #endif
 #ifdef ETUDIANTS_TP
-  int page = FindFreePage();
+  int page = -1;
+  if (g_cfg->LocalReplacement && owner->residentPages >= owner->residentTarget) {
+    page = EvictPage(owner);
+    if (page != -1 && owner->residentPages > owner->residentTarget) {
+      int extra = EvictPage(owner);
+      if (extra != -1)
+	RemovePhysicalToVirtualMapping(extra);
+    }
+  }
+  bool filled = false;
   if (page == -1) {
-    page = EvictPage();
+    page = FindFreePage(zeroFill);
+    filled = zeroFill;
   }
+  if (page == -1) {
+    page = EvictPage(NULL);
+    filled = false;
+  }
+  if (zeroFill && !filled)
+    memset(&(g_machine->mainMemory[page * g_cfg->PageSize]), 0,
+	   g_cfg->PageSize);
   tpr[page].virtualPage = virtualPage;
-  tpr[page].owner = owner;
+  SetOwner(page, owner);
+  tpr[page].refCount = 1;
+  ASSERT(tpr[page].sharers == NULL);
   tpr[page].locked = true;
+  policy->numFaults++;
+  policy->PageMapped(page);
+
+  // Memory is getting short: let the cleaner prepare the next evictions
+  if (numFree < lowWatermark && cleanerIdle) {
+    cleanerIdle = false;
+    cleanerWakeUp->V();
+  }
   return page;
 #endif
 }
@@ -141,27 +492,46 @@ int PhysicalMemManager::AddPhysicalToVirtualMapping(AddrSpace* owner,int virtual
 /*! This method returns a new physical page number, if it finds one
 //  free. If not, return -1. Does not run the clock algorithm.
 //
+//  The bottom numZeroed entries of the free stack are pages already
+//  zeroed (see ZeroFreePages). A page to fill with zeroes is taken
+//  from them, its slot being filled with the top of the stack; other
+//  pages are popped from the top, so that the zeroed pages are kept.
+//
+//  \param zeroFill is true if the page must be filled with zeroes
 //  \return A new free physical page number.
 */
 //-----------------------------------------------------------------
-int PhysicalMemManager::FindFreePage() {
+int PhysicalMemManager::FindFreePage(bool zeroFill) {
   int64_t page;
 
-  // Check that the free list is not empty
-  if (free_page_list.IsEmpty())
+  // Check that the free stack is not empty
+  if (numFree == 0)
     return -1;
 
   // Update statistics
   g_current_thread->GetProcessOwner()->stat->incrMemoryAccess();
 
-  // Get a page from the free list
-  page = (int64_t)free_page_list.Remove();
+  if (zeroFill && numZeroed > 0) {
+    // Take a zeroed page
+    page = free_stack[--numZeroed];
+    free_stack[numZeroed] = free_stack[--numFree];
+    numZeroHits++;
+  } else {
+    // Pop a page from the free stack
+    page = free_stack[--numFree];
+    if (numZeroed > numFree)
+      numZeroed = numFree;
+    if (zeroFill)
+      memset(&(g_machine->mainMemory[page * g_cfg->PageSize]), 0,
+	     g_cfg->PageSize);
+  }
 
   // Check that the page is really free
   ASSERT(tpr[page].free);
 
   // Update the physical page table
   tpr[page].free = false;
+  tpr[page].refCount = 1;
 
   return page;
 }
@@ -169,76 +539,533 @@ int PhysicalMemManager::FindFreePage() {
 //-----------------------------------------------------------------
 // PhysicalMemManager::EvictPage
 //
-/*! This method implements page replacement, using the well-known
-//  clock algorithm.
+/*! This method implements page replacement: the victim is chosen
+//  by the replacement policy, unmapped from all the address spaces
+//  it is mapped in, then written back to the swap area or to its
+//  mapped file if needed. When all the pages are locked, the
+//  current thread yields until a page fault in progress completes.
 //
-//  \return A new free physical page number.
+//  \param space is the address space to take the page from (local
+//         replacement), NULL for any
+//  \return A new free physical page number, -1 if space has no page
+//          that can be evicted
 */
 //-----------------------------------------------------------------
-int PhysicalMemManager::EvictPage() {
+int PhysicalMemManager::EvictPage(AddrSpace *space) {
 #ifndef ETUDIANTS_TP
   printf("**** Warning: page replacement algorithm is not implemented yet\n");
   exit(-1);
   return (0);
 #endif
 #ifdef ETUDIANTS_TP
-  int local_i_clock = (i_clock + 1) % g_cfg->NumPhysPages;
-  int i = 0;
-
-  // search for a page that isn't locked or used recently
-  while ((tpr[local_i_clock].owner->translationTable->getBitU(tpr[local_i_clock].virtualPage)) || (tpr[local_i_clock].locked)) {
-    tpr[local_i_clock].owner->translationTable->clearBitU(tpr[local_i_clock].virtualPage);
-    i++;
-    // back at beginning means we found nothing
-    if (i > g_cfg->NumPhysPages) {
-      i_clock = local_i_clock;
-      g_current_thread->Yield();
-    }
-    local_i_clock = (local_i_clock + 1) % g_cfg->NumPhysPages;
+  int local_i_clock;
+
+  while ((local_i_clock = policy->ChooseVictim(space)) == -1) {
+    if (space != NULL)
+      return -1;
+    // The pages are released by threads of any priority
+    g_current_thread->Yield(true);
   }
 
-  i_clock = local_i_clock;
-  tpr[local_i_clock].owner->translationTable->clearBitValid(tpr[local_i_clock].virtualPage);
+  policy->PageUnmapped(local_i_clock);
+  UncacheText(local_i_clock);
+  policy->numEvictions++;
   tpr[local_i_clock].locked = true;
 
-  // copy page in swap.
-  TranslationTable* tt = tpr[local_i_clock].owner->translationTable;
-  int vpn = tpr[local_i_clock].virtualPage;
+  // Unmap the page everywhere. A valid page is never under I/O, and
+  // the I/O bit makes faults on it, and the destruction of its
+  // address spaces, wait until the page is saved.
+  AddrSpace *o;
+  int v;
+  for (int k = 0; k < tpr[local_i_clock].refCount; k++) {
+    Mapping(local_i_clock, k, &o, &v);
+    ASSERT(!o->translationTable->getBitIo(v));
+    o->translationTable->clearBitValid(v);
+    o->translationTable->setBitIo(v);
+  }
+
+  // A page that was not modified since it was loaded, or since the
+  // cleaner wrote it back, can be read again from where it came from
+  if (WriteBack(local_i_clock))
+    policy->numWriteBacks++;
+  if (IsDirty(local_i_clock)) {
+    printf("Not enough swap space to evict a page\n");
+    g_machine->interrupt->Halt(-1);
+  }
 
-  while(tt->getBitIo(vpn)) {
-    g_current_thread->Yield();
+  for (int k = 0; k < tpr[local_i_clock].refCount; k++) {
+    Mapping(local_i_clock, k, &o, &v);
+    o->translationTable->clearBitIo(v);
+    g_page_waits->Wake(o, v);
   }
-  tt->setBitIo(vpn);
+  FreeSharers(local_i_clock);
+  ChangeOwner(local_i_clock, g_current_thread);
+
+  return local_i_clock;
+#endif
+}
 
-  AddrSpace *as = g_current_thread->GetProcessOwner()->addrspace;
-  OpenFile *f = as->findMappedFile(vpn * g_cfg->PageSize);
+//-----------------------------------------------------------------
+// PhysicalMemManager::WriteBack
+//
+/*! This method saves a dirty page to its mapped file, or to the swap
+//  area (allocating a swap sector the first time), and clears its M
+//  bit. Clean pages are left alone: they can be read again from
+//  their file, their swap sector, or zero-filled.
+//
+//  The page must be locked. It may still be valid (page cleaner):
+//  its contents are then copied before the first disk access, right
+//  after clearing M, so a modification made during the write sets M
+//  again and is not lost.
+//
+//  A swap sector shared with another address space (after a Fork)
+//  is never overwritten: a new sector is allocated instead. A page
+//  shared by several address spaces is written once, and all its
+//  mappings then share the new sector.
+//
+//  \param page is the physical page to save
+//  \return true if the page was written to disk. If there was no swap
+//          space left, the page stays dirty.
+*/
+//-----------------------------------------------------------------
+bool PhysicalMemManager::WriteBack(int page) {
+  TranslationTable *tt = tpr[page].owner->translationTable;
+  int vpn = tpr[page].virtualPage;
+  char *data = (char *)(g_machine->mainMemory + page * g_cfg->PageSize);
+  char *copy = NULL;
+
+  AddrSpace *o;
+  int v;
+
+  ASSERT(tpr[page].locked);
+  if (!IsDirty(page))
+    return false;
+
+  for (int k = 0; k < tpr[page].refCount; k++) {
+    Mapping(page, k, &o, &v);
+    o->translationTable->clearBitM(v);
+  }
+  if (tt->getBitValid(vpn)) {
+    copy = new char[g_cfg->PageSize];
+    memcpy(copy, data, g_cfg->PageSize);
+    data = copy;
+  }
+
+  OpenFile *f = tpr[page].owner->findMappedFile(vpn * g_cfg->PageSize);
   if (f != NULL) { // mapped file
-    if (tt->getBitM(vpn)) {
-      int ad = tt->getAddrDisk(vpn);
-      f->WriteAt((char*) (g_machine->mainMemory + local_i_clock * g_cfg->PageSize), g_cfg->PageSize, ad);
-    }
+    f->WriteAt(data, g_cfg->PageSize, tt->getAddrDisk(vpn));
+  } else if (tpr[page].refCount == 1 && tt->getBitSwap(vpn)
+	     && !g_swap_manager->IsPageSwapShared(tt->getAddrDisk(vpn))) {
+    int addrDisk = tt->getAddrDisk(vpn);
+    tt->setAddrDisk(vpn, -1);
+    g_swap_manager->PutPageSwap(addrDisk, data);
+    tt->setAddrDisk(vpn, addrDisk);
+    g_page_waits->Wake(tpr[page].owner, vpn);
   } else {
-    if (tt->getBitSwap(vpn)) {
-      if(tt->getBitM(vpn)) {
-        int addrDisk = tt->getAddrDisk(vpn);
-        tt->setAddrDisk(vpn, -1);
-        g_swap_manager->PutPageSwap(addrDisk, (char*) (g_machine->mainMemory + local_i_clock * g_cfg->PageSize));
-        tt->setAddrDisk(vpn, addrDisk);
-      }
-    } else {
-      tt->setAddrDisk(vpn, -1);
-      int swapAddr = g_swap_manager->PutPageSwap(-1, (char*) (g_machine->mainMemory + local_i_clock * g_cfg->PageSize));
-      tt->setAddrDisk(vpn, swapAddr);
-      tt->setBitSwap(vpn);
+    int swapAddr = g_swap_manager->AllocPageSwap(SwapHint(tt, vpn));
+    if (swapAddr == -1) {
+      tt->setBitM(vpn);
+      delete[] copy;
+      return false;
+    }
+    g_swap_manager->PutPageSwap(swapAddr, data);
+    for (int k = 0; k < tpr[page].refCount; k++) {
+      Mapping(page, k, &o, &v);
+      TranslationTable *ott = o->translationTable;
+      if (ott->getBitSwap(v))
+	g_swap_manager->ReleasePageSwap(ott->getAddrDisk(v));
+      if (k > 0)
+	g_swap_manager->SharePageSwap(swapAddr);
+      ott->setAddrDisk(v, swapAddr);
+      ott->setBitSwap(v);
     }
   }
+  delete[] copy;
+  return true;
+}
 
-  ChangeOwner(local_i_clock, g_current_thread);
+//-----------------------------------------------------------------
+// PhysicalMemManager::SwapHint
+//
+/*! Look for the closest virtual page around vpn, at most
+//  SWAP_CLUSTER pages away, which already has a swap sector, and
+//  return the sector vpn would have if the pages were stored
+//  contiguously. Sequentially evicted pages thus end up in
+//  consecutive sectors, and are later read back with few seeks.
+//
+//  \param tt is the translation table of the address space
+//  \param vpn is the virtual page needing a swap sector
+//  \return the preferred sector, -1 if there is none
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::SwapHint(TranslationTable *tt, int vpn) {
+  for (int d = 1; d < SWAP_CLUSTER; d++) {
+    if (vpn - d >= 0 && tt->getBitSwap(vpn - d)
+	&& tt->getAddrDisk(vpn - d) >= 0)
+      return tt->getAddrDisk(vpn - d) + d;
+    if (vpn + d < tt->getMaxNumPages() && tt->getBitSwap(vpn + d)
+	&& tt->getAddrDisk(vpn + d) >= d)
+      return tt->getAddrDisk(vpn + d) - d;
+  }
+  return -1;
+}
 
-  tt->clearBitIo(vpn);
+//-----------------------------------------------------------------
+// PhysicalMemManager::WriteBackCluster
+//
+/*! Write back a dirty page, together with the following dirty
+//  pages of the same address space when their swap sectors are
+//  consecutive (or can be allocated so), in a single disk transfer.
+//  Pages of mapped files, and pages shared by several address spaces,
+//  are written back one at a time.
+//
+//  \param page is the physical page to save (not locked)
+//  \return the number of pages written back
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::WriteBackCluster(int page) {
+  AddrSpace *owner = tpr[page].owner;
+  TranslationTable *tt = owner->translationTable;
+  int vpn = tpr[page].virtualPage;
+  int first, n;
+  bool fresh[SWAP_CLUSTER];
 
-  return local_i_clock;
-#endif
+  ASSERT(!tpr[page].locked);
+  if (owner->findMappedFile(vpn * g_cfg->PageSize) != NULL
+      || tpr[page].refCount > 1) {
+    tpr[page].locked = true;
+    n = WriteBack(page) ? 1 : 0;
+    UnlockPage(page);
+    return n;
+  }
+
+  // Sector of the first page (a sector shared after a Fork is replaced)
+  fresh[0] = !tt->getBitSwap(vpn)
+    || g_swap_manager->IsPageSwapShared(tt->getAddrDisk(vpn));
+  if (fresh[0]) {
+    first = g_swap_manager->AllocPageSwap(SwapHint(tt, vpn));
+    if (first == -1)
+      return 0;
+  } else
+    first = tt->getAddrDisk(vpn);
+  tpr[page].locked = true;
+
+  // Extend the cluster with the following dirty pages
+  for (n = 1; n < SWAP_CLUSTER && vpn + n < tt->getMaxNumPages(); n++) {
+    int v = vpn + n;
+    if (!tt->getBitValid(v) || !tt->getBitM(v)
+	|| tpr[tt->getPhysicalPage(v)].locked
+	|| tpr[tt->getPhysicalPage(v)].refCount > 1
+	|| owner->findMappedFile(v * g_cfg->PageSize) != NULL)
+      break;
+    fresh[n] = !tt->getBitSwap(v);
+    if (fresh[n] ? !g_swap_manager->ReservePageSwap(first + n)
+	: (tt->getAddrDisk(v) != first + n
+	   || g_swap_manager->IsPageSwapShared(first + n)))
+      break;
+    tpr[tt->getPhysicalPage(v)].locked = true;
+  }
+
+  // Take a copy of the pages, later modifications will set M again
+  char *data = new char[n * g_cfg->PageSize];
+  for (int i = 0; i < n; i++) {
+    tt->clearBitM(vpn + i);
+    memcpy(data + i * g_cfg->PageSize,
+	   g_machine->mainMemory + tt->getPhysicalPage(vpn + i) * g_cfg->PageSize,
+	   g_cfg->PageSize);
+  }
+  g_swap_manager->PutPagesSwap(first, n, data);
+  delete[] data;
+
+  for (int i = 0; i < n; i++) {
+    if (fresh[i]) {
+      if (tt->getBitSwap(vpn + i))
+	g_swap_manager->ReleasePageSwap(tt->getAddrDisk(vpn + i));
+      tt->setAddrDisk(vpn + i, first + i);
+      tt->setBitSwap(vpn + i);
+    }
+    UnlockPage(tt->getPhysicalPage(vpn + i));
+  }
+  DEBUG('v', (char *)"Cleaned %d pages from virtual page %d\n", n, vpn);
+  return n;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::NumCleanPages
+//
+/*! \return the number of pages that can be allocated without any
+//  disk write: free pages, and evictable pages that are not dirty.
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::NumCleanPages(void) {
+  int n = numFree;
+
+  for (int i = 0; i < g_cfg->NumPhysPages; i++)
+    if (!tpr[i].free && !tpr[i].locked && !IsDirty(i))
+      n++;
+  return n;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::CleanPass
+//
+/*! Write back dirty pages which were not referenced since the
+//  replacement policy last looked at them (these are the next
+//  eviction candidates), until about CLEANER_BATCH pages have been
+//  written. Each one is written along with its dirty successors
+//  (see WriteBackCluster). Pages are locked while they are written,
+//  so they are neither evicted nor freed.
+//
+//  \return the number of pages written back
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::CleanPass(void) {
+  int cleaned = 0;
+
+  for (int i = 0; i < g_cfg->NumPhysPages && cleaned < CLEANER_BATCH; i++) {
+    cleanHand = (cleanHand + 1) % g_cfg->NumPhysPages;
+    if (tpr[cleanHand].free || tpr[cleanHand].locked)
+      continue;
+    TranslationTable *tt = tpr[cleanHand].owner->translationTable;
+    int vpn = tpr[cleanHand].virtualPage;
+    if (tt->getBitU(vpn) || !IsDirty(cleanHand))
+      continue;
+    int n = WriteBackCluster(cleanHand);
+    cleaned += n;
+    numCleaned += n;
+  }
+  DEBUG('v', (char *)"Page cleaner wrote back %d pages\n", cleaned);
+  return cleaned;
+}
+
+//-----------------------------------------------------------------
+// PageCleaner
+//
+/*! Entry point of the page cleaner kernel thread.
+//
+//  \param arg is the PhysicalMemManager
+*/
+//-----------------------------------------------------------------
+static void PageCleaner(int64_t arg) {
+  ((PhysicalMemManager *)arg)->RunCleaner();
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::StartCleaner
+//
+/*! Start the page cleaner kernel thread. It sleeps until the number
+//  of free pages falls under the low watermark.
+//
+//  \param owner is the process the cleaner is attached to
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::StartCleaner(Process *owner) {
+  cleanerWakeUp = new Semaphore((char *)"page cleaner", 0);
+  Thread *t = new Thread((char *)"page cleaner");
+  t->StartKernel(owner, PageCleaner, (int64_t)this);
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::RunCleaner
+//
+/*! Body of the page cleaner. Once woken up, it writes back a batch
+//  of pages every CLEANER_PERIOD ticks, until free and clean pages
+//  reach the high watermark or there is nothing left to clean. It
+//  then sleeps again, without any pending alarm, so that it does not
+//  keep an idle machine running.
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::RunCleaner(void) {
+  for (;;) {
+    cleanerIdle = true;
+    cleanerWakeUp->P();
+    while (NumCleanPages() < highWatermark && CleanPass() > 0)
+      cleanerWakeUp->PTimed(CLEANER_PERIOD);
+  }
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::ZeroFreePages
+//
+/*! Zero some free pages, to serve the next anonymous page faults
+//  without zeroing a page on their path. Called while the machine
+//  is idle (see Interrupt::Idle), so this costs no simulated time.
+//  The pool is limited to zeroTarget pages, as pages taken for other
+//  uses are zeroed for nothing.
+//
+//  \param count is the maximum number of pages to zero
+//  \return the number of pages zeroed
+*/
+//-----------------------------------------------------------------
+int PhysicalMemManager::ZeroFreePages(int count) {
+  int n = 0;
+
+  while (n < count && numZeroed < numFree && numZeroed < zeroTarget) {
+    memset(&(g_machine->mainMemory[free_stack[numZeroed] * g_cfg->PageSize]),
+	   0, g_cfg->PageSize);
+    numZeroed++;
+    n++;
+  }
+  numPreZeroed += n;
+  return n;
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::AddSpace
+//
+/*! Register a new address space. It starts active, with the
+//  smallest resident set target. Only the address spaces running a
+//  program are counted by admission control: the empty one of the
+//  kernel threads never faults, and would otherwise hold a target
+//  forever and let the last user process be suspended with no other
+//  process left to resume it.
+//
+//  \param space is the new address space
+//  \param counted is true if it runs a program
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::AddSpace(AddrSpace *space, bool counted) {
+  space->residentPages = 0;
+  space->residentTarget = PFF_MIN_PAGES;
+  space->lastFault = g_stats->getTotalTicks();
+  space->suspended = false;
+  space->counted = counted;
+  if (counted) {
+    totalTarget += space->residentTarget;
+    numActive++;
+  }
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::RemoveSpace
+//
+/*! Forget an address space being deleted (its pages are already
+//  freed), and resume the suspended processes which now fit in
+//  memory.
+//
+//  \param space is the address space being deleted
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::RemoveSpace(AddrSpace *space) {
+  if (!space->counted)
+    return;
+  if (space->suspended) {
+    suspendedSpaces->RemoveItem(space);
+    space->suspended = false;
+  } else {
+    totalTarget -= space->residentTarget;
+    numActive--;
+  }
+  ResumeSpaces();
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::PageFaultFrequency
+//
+/*! Adjust the resident set target of an address space on a page
+//  fault (local replacement). A fault less than PageFaultInterval
+//  ticks after the previous one means the resident set is too small:
+//  the target grows by one page. Otherwise it shrinks by one page per
+//  PageFaultInterval ticks elapsed, down to PFF_MIN_PAGES.
+//
+//  Admission control: if the growth makes the targets of the active
+//  processes exceed the physical memory, the faulting process is
+//  suspended, and its threads block here until ResumeSpaces admits it
+//  again. Its pages, no longer referenced, are the first replaced by
+//  the others. The last active process is never suspended.
+//
+//  \param space is the address space of the faulting thread
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::PageFaultFrequency(AddrSpace *space) {
+  // All the pages but the zero page
+  int capacity = g_cfg->NumPhysPages - 1;
+
+  if (!space->counted)
+    return;
+  while (space->suspended)
+    g_page_waits->Wait(space, -1);
+
+  Time now = g_stats->getTotalTicks();
+  Time interval = now - space->lastFault;
+  int target = space->residentTarget;
+
+  space->lastFault = now;
+  if (interval < (Time)g_cfg->PageFaultInterval) {
+    if (target < capacity)
+      target++;
+  } else {
+    Time shrink = interval / g_cfg->PageFaultInterval;
+    if (shrink > (Time)(target - PFF_MIN_PAGES))
+      target = PFF_MIN_PAGES;
+    else
+      target -= shrink;
+  }
+  totalTarget += target - space->residentTarget;
+
+  if (target < space->residentTarget) {
+    space->residentTarget = target;
+    ResumeSpaces();
+    return;
+  }
+  space->residentTarget = target;
+
+  if (totalTarget > capacity && numActive > 1) {
+    DEBUG('v', (char *)"Address space %p suspended, resident set target %d\n",
+	  space, target);
+    space->suspended = true;
+    totalTarget -= target;
+    numActive--;
+    suspendedSpaces->Append(space);
+    numSuspensions++;
+    while (space->suspended)
+      g_page_waits->Wait(space, -1);
+  }
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::ResumeSpaces
+//
+/*! Resume the suspended processes, oldest first, as long as their
+//  resident set targets fit in the physical memory left by the
+//  active ones. A process is always resumed when no other is active.
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::ResumeSpaces(void) {
+  int capacity = g_cfg->NumPhysPages - 1;
+  AddrSpace *space;
+
+  while ((space = suspendedSpaces->getFirst()) != NULL
+	 && (numActive == 0
+	     || totalTarget + space->residentTarget <= capacity)) {
+    DEBUG('v', (char *)"Address space %p resumed\n", space);
+    suspendedSpaces->RemoveItem(space);
+    space->suspended = false;
+    space->lastFault = g_stats->getTotalTicks();
+    totalTarget += space->residentTarget;
+    numActive++;
+    g_page_waits->Wake(space, -1);
+  }
+}
+
+//-----------------------------------------------------------------
+// PhysicalMemManager::PrintStats
+//
+/*! print the fault and eviction counts of the replacement policy
+*/
+//-----------------------------------------------------------------
+void PhysicalMemManager::PrintStats(void) {
+  policy->PrintStats();
+  printf("Page cleaner: %d pages written back ahead of eviction\n",
+	 numCleaned);
+  printf("Text page cache: %d page faults resolved by sharing\n",
+	 numTextHits);
+  printf("Zero page pool: %d pages zeroed while idle, "
+	 "%d anonymous page faults served from it\n",
+	 numPreZeroed, numZeroHits);
+  if (g_cfg->LocalReplacement)
+    printf("Local replacement: %d processes suspended by admission control\n",
+	   numSuspensions);
 }
 
 //-----------------------------------------------------------------
@@ -20,7 +20,8 @@ class PhysicalMemManager;
 #include "kernel/synch.h"
 #include "kernel/system.h"
 #include "vm/swapManager.h"
-#include "utility/list.h"
+#include "vm/replacement.h"
+#include "utility/intrusivelist.h"
 
 //-----------------------------------------------------------------
 /*! \brief Implements the physical page management.
@@ -29,27 +30,116 @@ class PhysicalMemManager;
    top of the Nachos kernel. It keeps track of which physical pages are used
    and which are free. 
    
-   It processes a new page demand by applying the clock algorithm when 
-   there is no page available. It requires an access to the thread list
-   in order to choose which page will be swapped using the SwapManager
-   class.
+   It processes a new page demand by evicting a page when there is no
+   page available. The page to evict is chosen by a ReplacementPolicy
+   (see replacement.h), and written back using the SwapManager class.
+
+   After a Fork, a physical page may be mapped in several address
+   spaces (copy-on-write). Such a page is freed with its last
+   mapping, and evicting it unmaps it everywhere.
+
+   The read-only pages of executable files (text, rodata) are kept in
+   a page cache indexed by (file header sector, offset in the file),
+   so that processes running the same program share them instead of
+   each reading its own copy. A page leaves the cache when it is
+   freed or evicted; the cache itself holds no mapping.
+
+   Anonymous pages which are read before being written are all mapped
+   to a single zero page, copy-on-write. This page is locked forever,
+   is never mapped through AddPhysicalToVirtualMapping and has no
+   owner: it is neither evicted nor freed.
+
+   With the LocalReplacement option, each address space gets a
+   resident set target, adjusted on each of its page faults by their
+   frequency (PFF): faults closer than PageFaultInterval ticks grow
+   the target, rarer faults shrink it. A process owning as many pages
+   as its target replaces its own pages instead of taking free pages
+   or pages of the other processes. When the targets of the active
+   processes exceed the physical memory, the process whose fault
+   overcommits it is suspended (its threads block on their next page
+   fault) until the others shrink or exit.
+
+   Free pages are zeroed while the machine is idle, up to a small
+   pool kept at the bottom of the free stack, so that anonymous page
+   faults get a zero-filled page without zeroing it themselves.
+
+   To keep evictions cheap, a page cleaner kernel thread writes dirty
+   pages that are not referenced any more back ahead of time, so that
+   their eviction needs no disk write. It is woken up when the number
+   of free pages falls under a low watermark, and cleans pages at a
+   regular pace until free and clean pages reach a high watermark.
 */
 //-----------------------------------------------------------------
 
+//! Maximum number of pages written back by each pass of the cleaner
+#define CLEANER_BATCH 8
+
+//! Delay between two passes of the cleaner, in ticks
+#define CLEANER_PERIOD 2000
+
+//! Smallest resident set target of an address space (local replacement)
+#define PFF_MIN_PAGES 8
+
+//! Maximum number of free pages zeroed each time the machine is idle
+#define ZERO_BATCH 16
+
+//! Number of buckets of the hash table of the text page cache
+#define TEXT_CACHE_SIZE 64
+
 class PhysicalMemManager {
 public:
   PhysicalMemManager();   //!< initialize the memory manager
   ~PhysicalMemManager();  //!< de-allocate the page_flags bitmap
 
-  int AddPhysicalToVirtualMapping(AddrSpace* owner,int vp); //!< Finds a new page and adds a new page mapping
+  int AddPhysicalToVirtualMapping(AddrSpace* owner,int vp,
+				  bool zeroFill = false); //!< Finds a new page and adds a new page mapping
   void RemovePhysicalToVirtualMapping(long numPage); //!< Frees the page and deletes the existing page mapping
+  void ShareMapping(long numPage, AddrSpace *owner, int virtualPage); //!< Map a page in one more address space
+  void UnmapPage(long numPage, AddrSpace *owner, int virtualPage); //!< Delete one mapping, free the page with the last one
+  int GetRefCount(long numPage) { return tpr[numPage].refCount; } //!< Number of mappings of a page
   void ChangeOwner(long numPage, Thread* owner);   //!< Change the page owner
   void UnlockPage(long numPage); //!< Unlock physical page
+  void WaitUnlocked(long numPage); //!< Wait until a locked page is unlocked
   void Print(void); //!< Print the contents of a page
+  void PrintStats(void); //!< Print the statistics of the replacement policy
+  int NumFreePages(void) { return numFree; } //!< Number of free pages
+  int ZeroPage(void) { return zeroPage; } //!< The page filled with zeroes
+  bool IsZeroPage(long numPage) { return numPage == zeroPage; } //!< true for the zero page
+
+  int LookupText(int sector, int offset); //!< Page caching a piece of an executable, -1 if none
+  void CacheText(long numPage, int sector, int offset); //!< Enter a page in the text page cache
+  void UncacheFile(int sector); //!< Forget the cached pages of a file being removed
+
+  void AddSpace(AddrSpace *space, bool counted); //!< Give an initial resident set target to a new address space
+  void RemoveSpace(AddrSpace *space); //!< Forget an address space being deleted
+  void PageFaultFrequency(AddrSpace *space); //!< Adjust the resident set target on a page fault
+
+  int ZeroFreePages(int count); //!< Zero free pages ahead of anonymous page faults
+
+  void StartCleaner(Process *owner); //!< Start the page cleaner kernel thread
+  void RunCleaner(void);  //!< Body of the page cleaner (never returns)
  
 private:
-  int FindFreePage();            //!< Return a free page if there is one
-  int EvictPage();               //!< Return a free page when there is none
+  int FindFreePage(bool zeroFill = false); //!< Return a free page if there is one
+  int EvictPage(AddrSpace *space); //!< Return a free page when there is none
+  void SetOwner(long numPage, AddrSpace *owner); //!< Change the owner of a page, counting resident pages
+  void ResumeSpaces(void);       //!< Resume the suspended processes which fit in memory
+  bool WriteBack(int page);      //!< Save a locked page to disk if it is dirty
+  int WriteBackCluster(int page); //!< Save a dirty page and its dirty successors
+  int SwapHint(TranslationTable *tt, int vpn); //!< Sector next to the neighbours of vpn
+  void Mapping(int page, int k, AddrSpace **owner, int *virtualPage); //!< k-th mapping of a page
+  bool IsDirty(int page);        //!< true if the page is modified in any of its mappings
+  void FreeSharers(int page);    //!< Forget the additional mappings of a page
+  void UncacheText(int page);    //!< Remove a page from the text page cache
+
+  /*! \brief A mapping of a physical page, besides the one of its owner */
+  struct map_c {
+    AddrSpace *owner;		//!< Address space the page is mapped in
+    int virtualPage;		//!< Virtual page mapping it
+    map_c *next;		//!< Next mapping of the same page
+  };
+  int CleanPass(void);           //!< Write back some dirty unreferenced pages
+  int NumCleanPages(void);       //!< Number of free or clean evictable pages
 
   /*! \brief Describes the allocation of physical pages. Bits U (used/referenced) and M
     (modified/dirty) are in the page table entry and are directly set by the MMU hardware */
@@ -58,15 +148,45 @@ private:
     bool locked;              //!< true if page is locked in memory (system page or page under sap in/out)
     int virtualPage;		//!< Number of the virtualPage which references this real page
     AddrSpace* owner;	//!< Address space of the owner process
+    int refCount;		//!< Number of mappings of the page (owner included)
+    map_c *sharers;		//!< Mappings other than the owner's (after a Fork)
+    int textSector;		//!< Header sector of the executable cached, -1 if none
+    int textOffset;		//!< Offset of the page in this executable
+    ListHook<tpr_c> textHook;	//!< Links in a bucket of textCache
   }; 
 
+  //! Bucket of textCache where the page at offset in sector goes
+  IntrusiveList<tpr_c> *TextBucket(int sector, int offset);
+
   struct tpr_c *tpr;	//!< RealPage Array to know the state of each real page
 
-  Listint free_page_list; //!< List of available (unused) real page numbers
+  int *free_stack;      //!< Stack of the available (unused) real pages
+
+  IntrusiveList<tpr_c> *textCache[TEXT_CACHE_SIZE]; //!< Cached read-only executable pages
+  int numTextHits;      //!< Number of page faults resolved from the text cache
+  int zeroPage;         //!< Page shared by anonymous pages never written
+
+  ReplacementPolicy *policy;  //!< Chooses the pages to evict
+
+  int totalTarget;      //!< Sum of the resident set targets of the active processes
+  int numActive;        //!< Number of counted address spaces not suspended
+  IntrusiveList<AddrSpace> *suspendedSpaces; //!< Suspended address spaces, FIFO
+  int numSuspensions;   //!< Number of processes suspended by admission control
 
-  int i_clock;          //!< Index for clock_algorithm
+  int numFree;          //!< Number of pages in free_stack
+  int numZeroed;        //!< Number of zeroed pages, at the bottom of free_stack
+  int zeroTarget;       //!< Maximum number of zeroed free pages
+  int numPreZeroed;     //!< Number of pages zeroed by ZeroFreePages
+  int numZeroHits;      //!< Number of anonymous faults served by a zeroed page
+  int lowWatermark;     //!< Wake up the cleaner under this number of free pages
+  int highWatermark;    //!< Number of free or clean pages the cleaner aims at
+  int cleanHand;        //!< Last page examined by the cleaner
+  Semaphore *cleanerWakeUp; //!< The cleaner sleeps on it when idle
+  bool cleanerIdle;     //!< true if the cleaner waits on cleanerWakeUp
+  int numCleaned;       //!< Number of pages written back by the cleaner
 
   friend class AddrSpace;      //!< Direct access to page table for programm loading
+  friend class ReplacementPolicy; //!< Reads the state of the pages
 };
 
 #endif // __MEM_H
@@ -0,0 +1,357 @@
+//-----------------------------------------------------------------
+/*! \file replacement.cc
+//  \brief Routines of the page replacement policies
+//
+//  All the routines are called by the PhysicalMemManager with
+//  interrupts disabled or without blocking in between, so they need
+//  no synchronization of their own.
+*/
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.  
+//  See copyright_insa.h for copyright notice and limitation 
+//  of liability and disclaimer of warranty provisions.
+//-----------------------------------------------------------------
+
+#include "vm/physMem.h"
+#include "vm/replacement.h"
+
+//-----------------------------------------------------------------
+// ReplacementPolicy::ReplacementPolicy
+//
+/*! Constructor.
+//
+//  \param m is the physical memory whose pages are managed
+//  \param policyName is the name printed with the statistics
+*/
+//-----------------------------------------------------------------
+ReplacementPolicy::ReplacementPolicy(PhysicalMemManager *m,
+				     const char *policyName) {
+  mem = m;
+  name = policyName;
+  numFaults = numEvictions = numWriteBacks = 0;
+}
+
+//-----------------------------------------------------------------
+// ReplacementPolicy::Evictable, Table, VirtualPage, Owner
+//
+/*! Accessors to the physical page table of the PhysicalMemManager,
+//  for the policies.
+//
+//  \param page is a physical page number
+//  \param space restricts Evictable to the pages of an address space
+//         (local replacement), NULL for any page
+*/
+//-----------------------------------------------------------------
+bool ReplacementPolicy::Evictable(int page, AddrSpace *space) {
+  return !mem->tpr[page].free && !mem->tpr[page].locked
+    && (space == NULL || mem->tpr[page].owner == space);
+}
+
+TranslationTable *ReplacementPolicy::Table(int page) {
+  return mem->tpr[page].owner->translationTable;
+}
+
+int ReplacementPolicy::VirtualPage(int page) {
+  return mem->tpr[page].virtualPage;
+}
+
+AddrSpace *ReplacementPolicy::Owner(int page) {
+  return mem->tpr[page].owner;
+}
+
+//-----------------------------------------------------------------
+// ReplacementPolicy::PrintStats
+//
+/*! Print the statistics of the policy, at exit.
+*/
+//-----------------------------------------------------------------
+void ReplacementPolicy::PrintStats() {
+  printf("Page replacement (%s): %d page faults, %d evictions, "
+	 "%d write-backs\n", name, numFaults, numEvictions, numWriteBacks);
+}
+
+//-----------------------------------------------------------------
+// ClockPolicy::ClockPolicy
+//
+/*! Constructor. The hand starts before the first page.
+*/
+//-----------------------------------------------------------------
+ClockPolicy::ClockPolicy(PhysicalMemManager *m)
+  : ReplacementPolicy(m, "Clock") {
+  hand = -1;
+}
+
+//-----------------------------------------------------------------
+// ClockPolicy::ChooseVictim
+//
+/*! Move the hand until an evictable page with its U bit clear is
+//  found, clearing the U bits on the way. Two turns are enough: after
+//  the first one, no page has its U bit set any more.
+//
+//  \param space is the address space to take the page from, NULL
+//         for any
+//  \return the victim, -1 if all the pages are locked
+*/
+//-----------------------------------------------------------------
+int ClockPolicy::ChooseVictim(AddrSpace *space) {
+  for (int i = 0; i < 2 * g_cfg->NumPhysPages; i++) {
+    hand = (hand + 1) % g_cfg->NumPhysPages;
+    if (!Evictable(hand, space))
+      continue;
+    if (!Table(hand)->getBitU(VirtualPage(hand)))
+      return hand;
+    Table(hand)->clearBitU(VirtualPage(hand));
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------
+// WSClockPolicy::WSClockPolicy
+//
+/*! Constructor.
+*/
+//-----------------------------------------------------------------
+WSClockPolicy::WSClockPolicy(PhysicalMemManager *m)
+  : ReplacementPolicy(m, "WSClock") {
+  hand = -1;
+  lastUse = new Time[g_cfg->NumPhysPages];
+  for (int i = 0; i < g_cfg->NumPhysPages; i++)
+    lastUse[i] = 0;
+}
+
+WSClockPolicy::~WSClockPolicy() {
+  delete[] lastUse;
+}
+
+//-----------------------------------------------------------------
+// WSClockPolicy::PageMapped
+//
+/*! A page just faulted in is in the working set.
+*/
+//-----------------------------------------------------------------
+void WSClockPolicy::PageMapped(int page) {
+  lastUse[page] = g_stats->getTotalTicks();
+}
+
+//-----------------------------------------------------------------
+// WSClockPolicy::ChooseVictim
+//
+/*! Make one turn of the hand. A referenced page gets its time of
+//  last use updated; an unreferenced page that was not used for
+//  more than WorkingSetWindow ticks is out of the working set, and
+//  is evicted at once if it is clean.
+//
+//  Pages are written back synchronously by the PhysicalMemManager,
+//  so a dirty page out of the working set is only taken when the
+//  turn found no clean one. Failing that, the least recently used
+//  evictable page is taken.
+//
+//  \param space is the address space to take the page from, NULL
+//         for any
+//  \return the victim, -1 if all the pages are locked
+*/
+//-----------------------------------------------------------------
+int WSClockPolicy::ChooseVictim(AddrSpace *space) {
+  Time now = g_stats->getTotalTicks();
+  int dirtyOld = -1;
+  int oldest = -1;
+
+  for (int i = 0; i < g_cfg->NumPhysPages; i++) {
+    hand = (hand + 1) % g_cfg->NumPhysPages;
+    if (!Evictable(hand, space))
+      continue;
+    TranslationTable *tt = Table(hand);
+    int vpn = VirtualPage(hand);
+    if (tt->getBitU(vpn)) {
+      tt->clearBitU(vpn);
+      lastUse[hand] = now;
+    } else if (now - lastUse[hand] > (Time)g_cfg->WorkingSetWindow) {
+      if (!tt->getBitM(vpn))
+	return hand;
+      if (dirtyOld == -1)
+	dirtyOld = hand;
+    }
+    if (oldest == -1 || lastUse[hand] < lastUse[oldest])
+      oldest = hand;
+  }
+  if (dirtyOld != -1)
+    hand = dirtyOld;
+  else if (oldest != -1)
+    hand = oldest;
+  else
+    return -1;
+  return hand;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::TwoQPolicy
+//
+/*! Constructor. A1in gets a quarter of the physical pages, and A1out
+//  remembers as many evicted pages as half the physical pages (the
+//  values advised by Johnson and Shasha).
+*/
+//-----------------------------------------------------------------
+TwoQPolicy::TwoQPolicy(PhysicalMemManager *m)
+  : ReplacementPolicy(m, "2Q"),
+    a1in(&frame::hook), am(&frame::hook) {
+  frames = new frame[g_cfg->NumPhysPages];
+  for (int i = 0; i < g_cfg->NumPhysPages; i++)
+    frames[i].page = i;
+  a1inSize = 0;
+  kin = g_cfg->NumPhysPages / 4 + 1;
+  kout = g_cfg->NumPhysPages / 2 + 1;
+  a1out = new ghost[kout];
+  outFirst = outCount = 0;
+  ghostHits = 0;
+}
+
+TwoQPolicy::~TwoQPolicy() {
+  while (a1in.Remove() != NULL)
+    ;
+  while (am.Remove() != NULL)
+    ;
+  delete[] frames;
+  delete[] a1out;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::AddGhost
+//
+/*! Remember an evicted page in A1out, forgetting the oldest one if
+//  A1out is full.
+*/
+//-----------------------------------------------------------------
+void TwoQPolicy::AddGhost(AddrSpace *owner, int virtualPage) {
+  if (outCount == kout) {
+    outFirst = (outFirst + 1) % kout;
+    outCount--;
+  }
+  ghost *g = &a1out[(outFirst + outCount) % kout];
+  g->owner = owner;
+  g->virtualPage = virtualPage;
+  outCount++;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::RemoveGhost
+//
+/*! Look for a page in A1out, and forget it if found.
+//
+//  \return true if the page was in A1out
+*/
+//-----------------------------------------------------------------
+bool TwoQPolicy::RemoveGhost(AddrSpace *owner, int virtualPage) {
+  for (int i = 0; i < outCount; i++) {
+    ghost *g = &a1out[(outFirst + i) % kout];
+    if (g->owner == owner && g->virtualPage == virtualPage) {
+      // Fill the hole with the oldest ghost
+      *g = a1out[outFirst];
+      outFirst = (outFirst + 1) % kout;
+      outCount--;
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::PageMapped
+//
+/*! A page evicted recently from A1in and faulted in again is hot: it
+//  goes to Am. Other pages start in A1in.
+*/
+//-----------------------------------------------------------------
+void TwoQPolicy::PageMapped(int page) {
+  if (RemoveGhost(Owner(page), VirtualPage(page))) {
+    ghostHits++;
+    am.Append(&frames[page]);
+  } else {
+    a1in.Append(&frames[page]);
+    a1inSize++;
+  }
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::PageUnmapped
+//
+/*! Forget a page which is no longer mapped.
+*/
+//-----------------------------------------------------------------
+void TwoQPolicy::PageUnmapped(int page) {
+  if (a1in.Contains(&frames[page])) {
+    a1in.RemoveItem(&frames[page]);
+    a1inSize--;
+  } else
+    am.RemoveItem(&frames[page]);
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::Pick
+//
+/*! Walk a queue from its head for an evictable page. With
+//  secondChance, referenced pages have their U bit cleared and are
+//  moved to the tail (clock); otherwise the queue is a plain FIFO.
+//  Only the pages of space are considered, unless it is NULL.
+//
+//  \return the first page found, NULL if none
+*/
+//-----------------------------------------------------------------
+TwoQPolicy::frame *TwoQPolicy::Pick(IntrusiveList<frame> *queue,
+				    bool secondChance, AddrSpace *space) {
+  frame *f = queue->getFirst();
+  // Stop after two passes over the queue at most
+  for (int i = 0; f != NULL && i < 2 * g_cfg->NumPhysPages; i++) {
+    frame *next = queue->getNext(f);
+    if (Evictable(f->page, space)) {
+      TranslationTable *tt = Table(f->page);
+      if (!secondChance || !tt->getBitU(VirtualPage(f->page)))
+	return f;
+      tt->clearBitU(VirtualPage(f->page));
+      queue->RemoveItem(f);
+      queue->Append(f);
+      if (next == NULL)
+	next = queue->getFirst();
+    }
+    f = next;
+  }
+  return NULL;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::ChooseVictim
+//
+/*! Evict from A1in while it is larger than its target size (and
+//  remember the victim in A1out), otherwise run the clock over Am.
+//
+//  \param space is the address space to take the page from, NULL
+//         for any
+//  \return the victim, -1 if all the pages are locked
+*/
+//-----------------------------------------------------------------
+int TwoQPolicy::ChooseVictim(AddrSpace *space) {
+  frame *f = NULL;
+
+  if (a1inSize > kin || am.IsEmpty())
+    f = Pick(&a1in, false, space);
+  if (f == NULL)
+    f = Pick(&am, true, space);
+  if (f == NULL)
+    f = Pick(&a1in, false, space);
+  if (f == NULL)
+    return -1;
+  if (a1in.Contains(f))
+    AddGhost(Owner(f->page), VirtualPage(f->page));
+  return f->page;
+}
+
+//-----------------------------------------------------------------
+// TwoQPolicy::PrintStats
+//
+/*! Print the statistics, with the number of hits in A1out.
+*/
+//-----------------------------------------------------------------
+void TwoQPolicy::PrintStats() {
+  ReplacementPolicy::PrintStats();
+  printf("   %d faulted pages promoted to the hot queue\n", ghostHits);
+}
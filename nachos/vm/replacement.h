@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------
+/*! \file replacement.h
+    \brief Page replacement policies
+
+    The PhysicalMemManager asks its ReplacementPolicy which physical
+    page to evict when there is no free page left. The policy is told
+    each time a page gets mapped or unmapped, so that it can maintain
+    its own queues, and only selects the victim: writing the victim
+    back to disk is done by the PhysicalMemManager.
+
+    The policy is chosen by the ReplacementPolicy entry of nachos.cfg:
+    - Clock: the classical single-hand clock (second chance)
+    - WSClock: clock over the working set of the pages, preferring
+      clean pages out of the working set (no write-back needed)
+    - 2Q: new pages wait in a FIFO (A1in) and only move to the main
+      clock queue (Am) if they are faulted in again shortly after their
+      eviction, so that a scan does not flush the hot pages
+
+    Copyright (c) 1999-2000 INSA de Rennes.
+    All rights reserved.  
+    See copyright_insa.h for copyright notice and limitation 
+    of liability and disclaimer of warranty provisions.
+*/
+//-----------------------------------------------------------------
+
+#ifndef __REPLACEMENT_H
+#define __REPLACEMENT_H
+
+#include "kernel/addrspace.h"
+#include "utility/intrusivelist.h"
+
+class PhysicalMemManager;
+
+//-----------------------------------------------------------------
+/*! \brief Interface of the page replacement policies
+*/
+//-----------------------------------------------------------------
+class ReplacementPolicy {
+public:
+  ReplacementPolicy(PhysicalMemManager *m, const char *policyName);
+  virtual ~ReplacementPolicy() {}
+
+  //! Page page was just given to a virtual page (owner already set)
+  virtual void PageMapped(int page) {}
+
+  //! Page page is no longer mapped (freed, or chosen as a victim)
+  virtual void PageUnmapped(int page) {}
+
+  //! Choose a page to evict among the pages owned by space (any page
+  //! if space is NULL), -1 if all these pages are locked
+  virtual int ChooseVictim(AddrSpace *space) = 0;
+
+  //! Print the fault and eviction counts
+  virtual void PrintStats();
+
+  int numFaults;      //!< Number of pages mapped on page faults
+  int numEvictions;   //!< Number of pages evicted
+  int numWriteBacks;  //!< Number of evicted pages written to disk
+
+protected:
+  //! true if page may be evicted (mapped, not locked, and owned by
+  //! space unless space is NULL)
+  bool Evictable(int page, AddrSpace *space);
+
+  //! Translation table and virtual page mapped on page page
+  TranslationTable *Table(int page);
+  int VirtualPage(int page);
+
+  //! Address space owning page page
+  AddrSpace *Owner(int page);
+
+  PhysicalMemManager *mem;  //!< Physical memory whose pages are managed
+  const char *name;         //!< Name of the policy, for statistics
+};
+
+//-----------------------------------------------------------------
+/*! \brief Single-hand clock: evict the first page not referenced
+  since the previous turn of the hand
+*/
+//-----------------------------------------------------------------
+class ClockPolicy : public ReplacementPolicy {
+public:
+  ClockPolicy(PhysicalMemManager *m);
+  int ChooseVictim(AddrSpace *space);
+
+private:
+  int hand;   //!< Last page examined
+};
+
+//-----------------------------------------------------------------
+/*! \brief WSClock: clock over the time of last use of the pages
+*/
+//-----------------------------------------------------------------
+class WSClockPolicy : public ReplacementPolicy {
+public:
+  WSClockPolicy(PhysicalMemManager *m);
+  ~WSClockPolicy();
+  void PageMapped(int page);
+  int ChooseVictim(AddrSpace *space);
+
+private:
+  int hand;        //!< Last page examined
+  Time *lastUse;   //!< Time of last known reference of each page
+};
+
+//-----------------------------------------------------------------
+/*! \brief 2Q: FIFO for the pages referenced once, clock for the
+  pages referenced again after their eviction
+*/
+//-----------------------------------------------------------------
+class TwoQPolicy : public ReplacementPolicy {
+public:
+  TwoQPolicy(PhysicalMemManager *m);
+  ~TwoQPolicy();
+  void PageMapped(int page);
+  void PageUnmapped(int page);
+  int ChooseVictim(AddrSpace *space);
+  void PrintStats();
+
+private:
+  //! Queue element, one per physical page
+  struct frame {
+    int page;                 //!< Physical page number
+    ListHook<frame> hook;     //!< Links in a1in or am
+  };
+
+  //! Evicted page remembered in A1out (no physical page)
+  struct ghost {
+    AddrSpace *owner;
+    int virtualPage;
+  };
+
+  //! Take the first evictable page of queue, NULL if none
+  frame *Pick(IntrusiveList<frame> *queue, bool secondChance,
+	      AddrSpace *space);
+
+  //! Remember / forget an evicted page in A1out
+  void AddGhost(AddrSpace *owner, int virtualPage);
+  bool RemoveGhost(AddrSpace *owner, int virtualPage);
+
+  frame *frames;              //!< Queue elements of the physical pages
+  IntrusiveList<frame> a1in;  //!< Pages referenced once, FIFO
+  IntrusiveList<frame> am;    //!< Hot pages, clock
+  int a1inSize;               //!< Number of pages in a1in
+  int kin;                    //!< Target size of a1in
+
+  ghost *a1out;               //!< Circular FIFO of evicted pages
+  int kout;                   //!< Capacity of a1out
+  int outFirst;               //!< Oldest ghost
+  int outCount;               //!< Number of ghosts
+  int ghostHits;              //!< Faults on pages found in a1out
+};
+
+#endif // __REPLACEMENT_H
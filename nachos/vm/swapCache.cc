@@ -0,0 +1,355 @@
+//-----------------------------------------------------------------
+/*! \file  swapCache.cc
+//  \brief Routines of the compressed swap cache
+//
+//  Copyright (c) 1999-2000 INSA de Rennes.
+//  All rights reserved.
+//  See copyright_insa.h for copyright notice and limitation
+//  of liability and disclaimer of warranty provisions.
+//
+*/
+//-----------------------------------------------------------------
+
+#include <string.h>
+
+#include "kernel/system.h"
+#include "utility/config.h"
+#include "machine/disk.h"
+#include "vm/swapCache.h"
+
+//! Shortest match encoded as a back-reference
+#define LZ_MIN_MATCH 4
+
+//! Longest match encoded as a back-reference
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 127)
+
+//! Longest run of literals encoded at once
+#define LZ_MAX_LITERALS 128
+
+//! Number of entries of the hash table of the compressor
+#define LZ_HASH_SIZE 256
+
+//-----------------------------------------------------------------
+/** Hash the LZ_MIN_MATCH bytes at p */
+//-----------------------------------------------------------------
+static unsigned LzHash(const unsigned char *p) {
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  return (v * 2654435761U) >> 24;
+}
+
+//-----------------------------------------------------------------
+/** Append the literals in[from..to[ to the compressed output
+ *
+ * \return false if the output would not fit in limit bytes
+ */
+//-----------------------------------------------------------------
+static bool LzLiterals(const unsigned char *in, int from, int to,
+		       unsigned char *out, int *o, int limit) {
+  while (from < to) {
+    int n = to - from;
+    if (n > LZ_MAX_LITERALS)
+      n = LZ_MAX_LITERALS;
+    if (*o + 1 + n > limit)
+      return false;
+    out[(*o)++] = n - 1;
+    memcpy(out + *o, in + from, n);
+    *o += n;
+    from += n;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------
+/** Compress a buffer with a small LZ77 coder, in the spirit of LZ4.
+ *  The output is a sequence of tokens: a byte c < 128 followed by
+ *  c+1 literal bytes, or a byte 128+l followed by a 16-bit distance,
+ *  to copy l+LZ_MIN_MATCH bytes found that far back in the output.
+ *
+ * \param in: data to compress
+ * \param n: size of the data
+ * \param out: buffer for the compressed data
+ * \param limit: size of out
+ * \return the size of the compressed data, -1 if it exceeds limit
+ */
+//-----------------------------------------------------------------
+static int LzCompress(const unsigned char *in, int n, unsigned char *out,
+		      int limit) {
+  int table[LZ_HASH_SIZE];
+  int o = 0, lit = 0, i = 0;
+
+  for (int h = 0; h < LZ_HASH_SIZE; h++)
+    table[h] = -1;
+
+  while (i + LZ_MIN_MATCH <= n) {
+    unsigned h = LzHash(in + i);
+    int cand = table[h];
+    table[h] = i;
+    if (cand < 0 || i - cand > 0xffff
+	|| memcmp(in + cand, in + i, LZ_MIN_MATCH) != 0) {
+      i++;
+      continue;
+    }
+    int len = LZ_MIN_MATCH;
+    while (i + len < n && len < LZ_MAX_MATCH && in[cand + len] == in[i + len])
+      len++;
+    if (!LzLiterals(in, lit, i, out, &o, limit) || o + 3 > limit)
+      return -1;
+    out[o++] = 0x80 | (len - LZ_MIN_MATCH);
+    out[o++] = (i - cand) >> 8;
+    out[o++] = (i - cand) & 0xff;
+    i += len;
+    lit = i;
+  }
+  if (!LzLiterals(in, lit, n, out, &o, limit))
+    return -1;
+  return o;
+}
+
+//-----------------------------------------------------------------
+/** Decompress data produced by LzCompress
+ *
+ * \param in: compressed data
+ * \param size: size of the compressed data
+ * \param out: buffer for the data
+ * \param n: size of the data once decompressed
+ */
+//-----------------------------------------------------------------
+static void LzDecompress(const unsigned char *in, int size,
+			 unsigned char *out, int n) {
+  int i = 0, o = 0;
+
+  while (i < size) {
+    int c = in[i++];
+    if (c < 0x80) {
+      ASSERT(o + c + 1 <= n);
+      memcpy(out + o, in + i, c + 1);
+      i += c + 1;
+      o += c + 1;
+    } else {
+      int len = (c & 0x7f) + LZ_MIN_MATCH;
+      int dist = (in[i] << 8) | in[i + 1];
+      i += 2;
+      ASSERT(dist > 0 && dist <= o && o + len <= n);
+      for (int k = 0; k < len; k++, o++) // matches may overlap
+	out[o] = out[o - dist];
+    }
+  }
+  ASSERT(o == n);
+}
+
+//-----------------------------------------------------------------
+/**
+ * Build an empty cache
+ *
+ * \param max_bytes: maximum number of bytes of compressed data
+ */
+//-----------------------------------------------------------------
+SwapCache::SwapCache(int max_bytes)
+  : lru(&entry_c::lruHook) {
+
+  entries = new struct entry_c[NUM_SECTORS];
+  for (int i = 0; i < NUM_SECTORS; i++) {
+    entries[i].data = NULL;
+    entries[i].present = false;
+    entries[i].spilling = false;
+    entries[i].gen = 0;
+  }
+  scratch = new char[g_cfg->PageSize];
+  budget = max_bytes;
+  used = 0;
+  numStored = numSameFilled = numHits = numSpilled = numRejected = 0;
+}
+
+//-----------------------------------------------------------------
+/** De-allocate the cache and the pages it holds */
+//-----------------------------------------------------------------
+SwapCache::~SwapCache() {
+
+  for (int i = 0; i < NUM_SECTORS; i++)
+    if (entries[i].present)
+      Remove(i);
+  delete[] entries;
+  delete[] scratch;
+}
+
+//-----------------------------------------------------------------
+/** Remove the page of a sector from the cache
+ *
+ * \param num_sector: sector number in the swap area
+ */
+//-----------------------------------------------------------------
+void SwapCache::Remove(int num_sector) {
+  struct entry_c *e = &entries[num_sector];
+
+  ASSERT(e->present);
+  lru.RemoveItem(e);
+  used -= e->size;
+  delete[] e->data;
+  e->data = NULL;
+  e->present = false;
+  e->spilling = false;
+  e->gen++;
+}
+
+//-----------------------------------------------------------------
+/** Copy a page from the cache. The page becomes the most recently
+ * used.
+ *
+ * \param num_sector: sector of the page in the swap area
+ * \param page: buffer where to put the page
+ * \return true if the page is in the cache
+ */
+//-----------------------------------------------------------------
+bool SwapCache::Get(int num_sector, char *page) {
+  struct entry_c *e = &entries[num_sector];
+
+  if (!e->present)
+    return false;
+  if (e->data == NULL) {
+    for (int i = 0; i < g_cfg->PageSize; i += 4)
+      memcpy(page + i, &e->fill, 4);
+  } else
+    LzDecompress((unsigned char *)e->data, e->size,
+		 (unsigned char *)page, g_cfg->PageSize);
+  lru.RemoveItem(e);
+  lru.Append(e);
+  numHits++;
+  return true;
+}
+
+//-----------------------------------------------------------------
+/** \return true if the page of a sector is in the cache
+ *
+ * \param num_sector: sector number in the swap area
+ */
+//-----------------------------------------------------------------
+bool SwapCache::Contains(int num_sector) {
+
+  return entries[num_sector].present;
+}
+
+//-----------------------------------------------------------------
+/** Store a page in the cache. A page filled with the same word is
+ * stored as this word; other pages are compressed, and rejected
+ * when they do not shrink by at least a quarter. The previous
+ * contents of the sector are dropped in any case.
+ *
+ * \param num_sector: sector of the page in the swap area
+ * \param page: the page to store
+ * \return true if the page was stored
+ */
+//-----------------------------------------------------------------
+bool SwapCache::Put(int num_sector, char *page) {
+  struct entry_c *e = &entries[num_sector];
+  int fill, i;
+
+  if (e->present)
+    Remove(num_sector);
+
+  memcpy(&fill, page, 4);
+  for (i = 4; i < g_cfg->PageSize; i += 4)
+    if (memcmp(page + i, &fill, 4) != 0)
+      break;
+
+  if (i >= g_cfg->PageSize) {
+    e->data = NULL;
+    e->size = 0;
+    e->fill = fill;
+    numSameFilled++;
+  } else {
+    int size = LzCompress((unsigned char *)page, g_cfg->PageSize,
+			  (unsigned char *)scratch, g_cfg->PageSize * 3 / 4);
+    if (size == -1) {
+      numRejected++;
+      return false;
+    }
+    e->data = new char[size];
+    memcpy(e->data, scratch, size);
+    e->size = size;
+  }
+  e->present = true;
+  e->spilling = false;
+  e->gen++;
+  used += e->size;
+  lru.Append(e);
+  numStored++;
+  return true;
+}
+
+//-----------------------------------------------------------------
+/** Forget the page of a sector, if it is in the cache
+ *
+ * \param num_sector: sector number in the swap area
+ */
+//-----------------------------------------------------------------
+void SwapCache::Drop(int num_sector) {
+
+  if (entries[num_sector].present)
+    Remove(num_sector);
+}
+
+//-----------------------------------------------------------------
+/** \return true if the cache holds more than its budget */
+//-----------------------------------------------------------------
+bool SwapCache::OverBudget() {
+
+  return used > budget;
+}
+
+//-----------------------------------------------------------------
+/** Choose the least recently used page not being spilled yet, mark
+ * it as being spilled and copy it, to write it to the swap disk.
+ *
+ * \param num_sector: where to store the sector of the page
+ * \param page: buffer where to put the page
+ * \param gen: where to store the version of the page
+ * \return false if there is no page to spill
+ */
+//-----------------------------------------------------------------
+bool SwapCache::Victim(int *num_sector, char *page, unsigned *gen) {
+  struct entry_c *e;
+
+  for (e = lru.getFirst(); e != NULL; e = lru.getNext(e))
+    if (!e->spilling)
+      break;
+  if (e == NULL)
+    return false;
+
+  *num_sector = e - entries;
+  *gen = e->gen;
+  e->spilling = true;
+  // Get would make it the most recently used
+  if (e->data == NULL) {
+    for (int i = 0; i < g_cfg->PageSize; i += 4)
+      memcpy(page + i, &e->fill, 4);
+  } else
+    LzDecompress((unsigned char *)e->data, e->size,
+		 (unsigned char *)page, g_cfg->PageSize);
+  return true;
+}
+
+//-----------------------------------------------------------------
+/** Remove a page from the cache once it is written to the swap disk,
+ * unless it was replaced or dropped while it was written.
+ *
+ * \param num_sector: sector of the page
+ * \param gen: version of the page returned by Victim
+ */
+//-----------------------------------------------------------------
+void SwapCache::Spilled(int num_sector, unsigned gen) {
+  struct entry_c *e = &entries[num_sector];
+
+  numSpilled++;
+  if (e->present && e->gen == gen)
+    Remove(num_sector);
+}
+
+//-----------------------------------------------------------------
+/** Print the statistics of the cache */
+//-----------------------------------------------------------------
+void SwapCache::PrintStats() {
+
+  printf("Swap cache: %d pages stored (%d same-filled), %d rejected, "
+	 "%d read back, %d spilled to disk, %d bytes held\n",
+	 numStored, numSameFilled, numRejected, numHits, numSpilled, used);
+}
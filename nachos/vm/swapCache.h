@@ -0,0 +1,142 @@
+//---------------------------------------------------------------
+/*! \file swapCache.h
+   \brief Data structures for the compressed swap cache
+
+   The swap cache keeps compressed images of swapped-out pages in
+   the memory of the host, in front of the swap disk. Pages filled
+   with the same word (typically zeroes) only cost this word; the
+   others are compressed with a small LZ77 coder, and are written to
+   the swap disk directly when they do not compress well.
+
+   The cache holds at most a given number of bytes of compressed
+   data. Beyond, the least recently used pages are spilled to their
+   sector of the swap disk by the SwapManager.
+
+    Copyright (c) 1999-2000 INSA de Rennes.
+    All rights reserved.
+    See copyright_insa.h for copyright notice and limitation
+    of liability and disclaimer of warranty provisions.
+
+*/
+//---------------------------------------------------------------
+
+#ifndef __SWAPCACHE_H
+#define __SWAPCACHE_H
+
+#include "utility/intrusivelist.h"
+
+//-----------------------------------------------------------------
+/*! \brief Implements the compressed swap cache
+
+   The cache is indexed by the sectors of the swap area allocated by
+   the SwapManager: a page in the cache is the current contents of
+   its sector, the copy on the swap disk (if any) is outdated.
+
+   A page being spilled stays in the cache until it is on the disk,
+   so that it can still be read meanwhile.
+*/
+//-----------------------------------------------------------------
+class SwapCache {
+public:
+
+  /** Build an empty cache
+   *
+   * \param max_bytes: maximum number of bytes of compressed data
+   */
+  SwapCache(int max_bytes);
+
+  /** De-allocate the cache and the pages it holds */
+  ~SwapCache();
+
+  /** Copy a page from the cache
+   *
+   * \param num_sector: sector of the page in the swap area
+   * \param page: buffer where to put the page
+   * \return true if the page is in the cache, false if it must be
+   *         read from the swap disk
+   */
+  bool Get(int num_sector, char *page);
+
+  /** \return true if the page of a sector is in the cache
+   *
+   * \param num_sector: sector number in the swap area
+   */
+  bool Contains(int num_sector);
+
+  /** Store a page in the cache, if it compresses well enough.
+   *  Otherwise the previous contents of the sector, if cached, are
+   *  dropped and the page must be written to the swap disk.
+   *
+   * \param num_sector: sector of the page in the swap area
+   * \param page: the page to store
+   * \return true if the page was stored
+   */
+  bool Put(int num_sector, char *page);
+
+  /** Forget the page of a sector (the sector is freed)
+   *
+   * \param num_sector: sector number in the swap area
+   */
+  void Drop(int num_sector);
+
+  /** \return true if the cache holds more than its budget */
+  bool OverBudget();
+
+  /** Choose the least recently used page that is not being spilled
+   *  yet, and get a copy of it to write it to the swap disk.
+   *
+   * \param num_sector: where to store the sector of the page
+   * \param page: buffer where to put the page
+   * \param gen: where to store the version of the page, to give to
+   *        Spilled
+   * \return false if there is no page to spill
+   */
+  bool Victim(int *num_sector, char *page, unsigned *gen);
+
+  /** Remove a page from the cache once it is written to the swap
+   *  disk, unless it was replaced or dropped in the meantime.
+   *
+   * \param num_sector: sector of the page
+   * \param gen: version of the page returned by Victim
+   */
+  void Spilled(int num_sector, unsigned gen);
+
+  /** Print the statistics of the cache */
+  void PrintStats();
+
+private:
+
+  /** A page held in the cache */
+  struct entry_c {
+    char *data;          //!< Compressed page, NULL for a same-filled page
+    int size;            //!< Size of data in bytes
+    int fill;            //!< Word repeated in a same-filled page
+    bool present;        //!< true if the sector is in the cache
+    bool spilling;       //!< true if being written to the swap disk
+    unsigned gen;        //!< Version of the page, changed at each Put
+    ListHook<entry_c> lruHook; //!< Links in lru
+  };
+
+  /** Remove the page of a sector from the cache */
+  void Remove(int num_sector);
+
+  /** One entry per sector of the swap area */
+  struct entry_c *entries;
+
+  /** Pages in the cache, least recently used first */
+  IntrusiveList<entry_c> lru;
+
+  /** Buffer holding a page being compressed */
+  char *scratch;
+
+  int budget;          //!< Maximum number of bytes of compressed data
+  int used;            //!< Number of bytes of compressed data held
+
+  int numStored;       //!< Number of pages stored
+  int numSameFilled;   //!< Number of pages stored as a single word
+  int numHits;         //!< Number of pages read from the cache
+  int numSpilled;      //!< Number of pages written to the disk
+  int numRejected;     //!< Number of pages not compressible enough
+};
+
+#endif // __SWAPCACHE_H
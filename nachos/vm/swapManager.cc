@@ -15,6 +15,8 @@
 #include "drivers/drvDisk.h"
 #include "utility/bitmap.h"
 #include "kernel/thread.h"
+#include "kernel/synch.h"
+#include "vm/swapCache.h"
 #include "vm/swapManager.h"
 
 //-----------------------------------------------------------------
@@ -30,6 +32,13 @@ SwapManager::SwapManager() {
   swap_disk = new DriverDisk("sem swap disk","lock swap disk",
 			     g_machine->diskSwap);
   page_flags = new BitMap(NUM_SECTORS);
+  share_count = new int[NUM_SECTORS];
+  for (int i = 0; i < NUM_SECTORS; i++)
+    share_count[i] = 0;
+  cache = NULL;
+  if (g_cfg->SwapCacheSize > 0)
+    cache = new SwapCache(g_cfg->SwapCacheSize);
+  write_lock = new Lock((char *)"lock swap writes");
 
 }
 
@@ -43,6 +52,9 @@ SwapManager::SwapManager() {
 SwapManager::~SwapManager() {
 
   delete page_flags;
+  delete[] share_count;
+  delete cache;
+  delete write_lock;
   delete swap_disk;
 
 }
@@ -51,7 +63,9 @@ SwapManager::~SwapManager() {
 /** Returns the number of a free page in the swap area
  *
  * This method scans the allocation bitmap page_flags to decide which
- * page is used
+ * page is used. The page is taken at the beginning of a run of
+ * SWAP_CLUSTER free pages when there is one, to leave room for the
+ * neighbours of the virtual page.
  *
  * \return Number of the found free page in the swap area, or -1 of
  * there is no page available
@@ -59,23 +73,55 @@ SwapManager::~SwapManager() {
 //-----------------------------------------------------------------
 int SwapManager::GetFreePage() {
   
-  // Scan the page allocation bitmap
-  for (int i=0;i<NUM_SECTORS;i++) {
-    if (! page_flags->Test(i)) {
-      // the page #i is free
-      page_flags->Mark(i);
-      return i;
-    }
-  }
+  // Scan the page allocation bitmap, a word at a time
+  int i = page_flags->FindRun(SWAP_CLUSTER);
+  if (i == -1)
+    i = page_flags->FindRun(1);
 
   // There is no available page, return -1
-  return -1;
+  if (i == -1)
+    return -1;
+
+  page_flags->Mark(i);
+  return i;
+}
+
+//-----------------------------------------------------------------
+/** Allocate a sector in the swap area, without writing it.
+ *
+ * \param hint: sector to use if it is free (-1 if none), typically
+ *        the sector following the one of the previous virtual page
+ * \return the allocated sector, or -1 if the swap area is full
+ */
+//-----------------------------------------------------------------
+int SwapManager::AllocPageSwap(int hint) {
+
+  if (ReservePageSwap(hint))
+    return hint;
+  return GetFreePage();
+}
+
+//-----------------------------------------------------------------
+/** Allocate a given sector in the swap area, if it is free.
+ *
+ * \param num_sector: the sector number to allocate
+ * \return true if the sector was free and is now allocated
+ */
+//-----------------------------------------------------------------
+bool SwapManager::ReservePageSwap(int num_sector) {
+
+  if (num_sector < 0 || num_sector >= NUM_SECTORS
+      || page_flags->Test(num_sector))
+    return false;
+  page_flags->Mark(num_sector);
+  return true;
 }
 
 //-----------------------------------------------------------------
 /** This method frees an unused page in the swap area by modifying the
  * page allocation bitmap. This method is called when exiting a
- * process to de-allocate its swap area
+ * process to de-allocate its swap area. A shared page is only freed
+ * by its last user.
  *
  *  \param num_sector: the sector number to free
 */
@@ -84,11 +130,43 @@ void SwapManager::ReleasePageSwap(int num_sector) {
 
   DEBUG('v',(char *)"Swap page %i released for thread \"%s\"\n",num_sector,
 	g_current_thread->GetName());
+  ASSERT(page_flags->Test(num_sector));
+  if (share_count[num_sector] > 0) {
+    share_count[num_sector]--;
+    return;
+  }
   // clear the #num_sector bit of page_flags
   page_flags->Clear(num_sector);
+  if (cache != NULL)
+    cache->Drop(num_sector);
 
 }
 
+//-----------------------------------------------------------------
+/** Add a user to a page of the swap area (the page is shared by a
+ *  parent and child process after a Fork)
+ *
+ *  \param num_sector: the sector number to share
+ */
+//-----------------------------------------------------------------
+void SwapManager::SharePageSwap(int num_sector) {
+
+  ASSERT(page_flags->Test(num_sector));
+  share_count[num_sector]++;
+}
+
+//-----------------------------------------------------------------
+/** \return true if a page of the swap area has several users, in
+ *  which case it must not be overwritten
+ *
+ *  \param num_sector: the sector number
+ */
+//-----------------------------------------------------------------
+bool SwapManager::IsPageSwapShared(int num_sector) {
+
+  return share_count[num_sector] > 0;
+}
+
 //-----------------------------------------------------------------
 /** Fill a buffer with the swap information in a specific sector in the swap area
  *
@@ -100,9 +178,57 @@ void SwapManager::GetPageSwap(int num_sector ,char* SwapPage ) {
   
   DEBUG('v',(char *)"Reading swap page %i for \"%s\"\n",num_sector,
 	g_current_thread->GetName());
+  if (cache != NULL && cache->Get(num_sector, SwapPage))
+    return;
   swap_disk->ReadSector(num_sector,SwapPage);
 }
 
+//-----------------------------------------------------------------
+/** Write a page to the swap cache, or to the swap disk if the cache
+ * is disabled or does not take it (the page does not compress well)
+ *
+ * \param num_sector: sector number in the swap area
+ * \param SwapPage: the page to write
+ */
+//-----------------------------------------------------------------
+void SwapManager::WritePage(int num_sector, char *SwapPage) {
+
+  if (cache != NULL && cache->Put(num_sector, SwapPage)) {
+    SpillCache();
+    return;
+  }
+  write_lock->Acquire();
+  swap_disk->WriteSector(num_sector, SwapPage);
+  write_lock->Release();
+}
+
+//-----------------------------------------------------------------
+/** Write the least recently used pages of the swap cache to the swap
+ * disk, until the cache is back under its budget. A page stays in
+ * the cache while it is written, so that it can still be read.
+ */
+//-----------------------------------------------------------------
+void SwapManager::SpillCache() {
+  char *page = NULL;
+  int num_sector;
+  unsigned gen;
+
+  while (cache->OverBudget()) {
+    if (page == NULL)
+      page = new char[g_cfg->PageSize];
+    write_lock->Acquire();
+    if (!cache->OverBudget() || !cache->Victim(&num_sector, page, &gen)) {
+      write_lock->Release();
+      break;
+    }
+    DEBUG('v',(char *)"Spilling swap page %i\n",num_sector);
+    swap_disk->WriteSector(num_sector, page);
+    cache->Spilled(num_sector, gen);
+    write_lock->Release();
+  }
+  delete[] page;
+}
+
 //-----------------------------------------------------------------
 /** This method puts a page into the swapping area. If the sector
  *  number given in parameters is set to -1, the swap manager
@@ -120,7 +246,7 @@ int SwapManager::PutPageSwap(int num_sector,char *SwapPage) {
   if (num_sector >= 0) {
     DEBUG('v',(char *)"Writing swap page %i for \"%s\"\n",num_sector,
 	    g_current_thread->GetName());
-    swap_disk->WriteSector(num_sector,SwapPage);
+    WritePage(num_sector,SwapPage);
     return num_sector;
   }
   else {
@@ -131,16 +257,90 @@ int SwapManager::PutPageSwap(int num_sector,char *SwapPage) {
     else {
       DEBUG('v',(char *)"Writing swap page %i for \"%s\"\n",newpage,
 	    g_current_thread->GetName());
-      swap_disk->WriteSector(newpage,SwapPage);
+      WritePage(newpage,SwapPage);
       return newpage;
     }
   }		 
 }
 
+//-----------------------------------------------------------------
+/** Read count pages from consecutive sectors of the swap area. The
+ * pages found in the swap cache are copied from it, the others are
+ * read in a single disk transfer per run of consecutive sectors.
+ *
+ * \param first_sector: first sector number in the swap area
+ * \param count: number of pages to read
+ * \param SwapPages: the count buffers where to put the pages
+ */
+//-----------------------------------------------------------------
+void SwapManager::GetPagesSwap(int first_sector, int count, char** SwapPages) {
+
+  DEBUG('v',(char *)"Reading swap pages %i-%i for \"%s\"\n",first_sector,
+	first_sector + count - 1, g_current_thread->GetName());
+  int i = 0;
+  while (i < count) {
+    if (cache != NULL && cache->Get(first_sector + i, SwapPages[i])) {
+      i++;
+      continue;
+    }
+    int n = 1;
+    while (i + n < count && (cache == NULL || !cache->Contains(first_sector + i + n)))
+      n++;
+    swap_disk->ReadSectors(first_sector + i, n, SwapPages + i);
+    i += n;
+  }
+}
+
+//-----------------------------------------------------------------
+/** Write count pages to consecutive sectors of the swap area. The
+ * pages taken by the swap cache stay in memory, the others are
+ * written in a single disk transfer per run of consecutive sectors.
+ * The sectors must have been allocated.
+ *
+ * \param first_sector: first sector number in the swap area
+ * \param count: number of pages to write
+ * \param SwapPages: buffer of count pages to transfer
+ */
+//-----------------------------------------------------------------
+void SwapManager::PutPagesSwap(int first_sector, int count, char* SwapPages) {
+
+  DEBUG('v',(char *)"Writing swap pages %i-%i for \"%s\"\n",first_sector,
+	first_sector + count - 1, g_current_thread->GetName());
+  for (int i = 0; i < count; i++)
+    ASSERT(page_flags->Test(first_sector + i));
+  int i = 0;
+  while (i < count) {
+    int n = 0;
+    while (i + n < count
+	   && (cache == NULL
+	       || !cache->Put(first_sector + i + n,
+			      SwapPages + (i + n) * g_cfg->PageSize)))
+      n++;
+    if (n > 0) {
+      write_lock->Acquire();
+      swap_disk->WriteSectors(first_sector + i, n,
+			      SwapPages + i * g_cfg->PageSize);
+      write_lock->Release();
+    }
+    i += n + 1;
+  }
+  if (cache != NULL)
+    SpillCache();
+}
+
 //-----------------------------------------------------------------
 /** This method gives to the DriverDisk for the swap area */
 //-----------------------------------------------------------------
 DriverDisk * SwapManager::GetSwapDisk ()
 {
   return swap_disk;
+}
+
+//-----------------------------------------------------------------
+/** Print the statistics of the swap cache */
+//-----------------------------------------------------------------
+void SwapManager::PrintStats()
+{
+  if (cache != NULL)
+    cache->PrintStats();
 }   
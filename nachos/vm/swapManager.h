@@ -21,6 +21,8 @@ class BackingStore;
 class DriverDisk;
 class BitMap;
 class OpenFile;
+class SwapCache;
+class Lock;
 
 //-----------------------------------------------------------------
 /*! \brief Implements the swap manager
@@ -31,10 +33,25 @@ class OpenFile;
    The class provides operations to:
      - save a page from a buffer to the swapping area, 
      - restore a page from the swapping area to a buffer,
+     - save or restore several pages held in consecutive sectors
+       at once,
+     - allocate a page close to a given sector, so that adjacent
+       virtual pages get adjacent sectors,
      - release an unused page in the swapping area,
+     - share a page between several address spaces (after a Fork):
+       the page is only freed when its last user releases it.
+
+   When g_cfg->SwapCacheSize is not null, pages are first stored
+   compressed in a SwapCache, and only reach the swap disk when they
+   do not compress well or when the cache is full. All the writes to
+   the swap disk are serialized by a lock, so that they reach the
+   disk in the order they were issued.
 */
 //-----------------------------------------------------------------
 
+//! Number of adjacent virtual pages clustered in consecutive sectors
+#define SWAP_CLUSTER 8
+
 class SwapManager {
 public:
 
@@ -72,17 +89,67 @@ public:
    */ 
   int PutPageSwap(int num_sector, char* SwapPage);
 
+  /** Read count pages from consecutive sectors of the swap area
+   *
+   * \param first_sector: first sector number in the swap area
+   * \param count: number of pages to read
+   * \param SwapPages: the count buffers where to put the pages (they
+   *        need not be contiguous, typically physical pages)
+   */
+  void GetPagesSwap(int first_sector, int count, char** SwapPages);
+
+  /** Write count pages to consecutive sectors of the swap area. The
+   *  sectors must have been allocated.
+   *
+   * \param first_sector: first sector number in the swap area
+   * \param count: number of pages to write
+   * \param SwapPages: buffer of count pages to transfer
+   */
+  void PutPagesSwap(int first_sector, int count, char* SwapPages);
+
+  /** Allocate a sector in the swap area, without writing it.
+   *
+   * \param hint: sector to use if it is free (-1 if none)
+   * \return the allocated sector, or -1 if the swap area is full
+   */
+  int AllocPageSwap(int hint);
+
+  /** Allocate a given sector in the swap area, if it is free.
+   *
+   * \param num_sector: the sector number to allocate
+   * \return true if the sector was free and is now allocated
+   */
+  bool ReservePageSwap(int num_sector);
+
   /** This method frees an unused page in the swap area by modifying the
    * page allocation bitmap. This method is called when exiting a
-   * process to de-allocate its swap area
+   * process to de-allocate its swap area. A shared page is only freed
+   * by its last user.
    *
    *  \param num_sector: the sector number to free
    */ 
   void ReleasePageSwap(int num_sector); 
 
+  /** Add a user to a page of the swap area (the page is shared by a
+   *  parent and child process after a Fork)
+   *
+   *  \param num_sector: the sector number to share
+   */
+  void SharePageSwap(int num_sector);
+
+  /** \return true if a page of the swap area has several users, in
+   *  which case it must not be overwritten
+   *
+   *  \param num_sector: the sector number
+   */
+  bool IsPageSwapShared(int num_sector);
+
   /** This method gives access to the swapdisk's driver */
   DriverDisk * GetSwapDisk ();   
 
+  /** Print the statistics of the swap cache */
+  void PrintStats();
+
 private:
 
   /** Disk containing the swap area */
@@ -91,10 +158,34 @@ private:
   /** Bitmap used to know if sectors in the swap area are free or busy */
   BitMap *page_flags; 
 
+  /** Number of users of each sector of the swap area, besides the
+      first one */
+  int *share_count;
+
+  /** Compressed pages not written to the disk yet, NULL if disabled */
+  SwapCache *cache;
+
+  /** Serializes the writes to the swap disk */
+  Lock *write_lock;
+
+  /** Write a page to the swap cache, or to the swap disk if the
+   *  cache does not take it
+   *
+   * \param num_sector: sector number in the swap area
+   * \param SwapPage: the page to write
+   */
+  void WritePage(int num_sector, char *SwapPage);
+
+  /** Write the least recently used pages of the swap cache to the
+   *  swap disk, until the cache is back under its budget */
+  void SpillCache();
+
   /** Returns the number of a free page in the swap area
    *
    * This method scans the allocation bitmap page_flags to decide which
-   * page is used
+   * page is used. The page is taken at the beginning of a run of
+   * SWAP_CLUSTER free pages when there is one, to leave room for the
+   * neighbours of the virtual page.
    *
    * \return Number of the found free page in the swap area, or -1 of
    * there is no page available